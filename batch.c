@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "service.h"
+
+// Batch query runner: answers a file of server requests (one per line, see service.h) on a
+// pool of threads and writes the replies in input order.
+//   batch [--threads N] [--candidates K] [--algorithm NAME] [--landmarks K] [--landmark-select avoid|farthest] [--cache MB] [--cache-bucket MIN] [--simplify] [--out FILE] [--stats FILE] QUERIES
+// Each worker starts with an equal contiguous slice of the queries and claims them from the
+// front; a worker that runs dry steals the back half of another worker's remaining slice, so
+// a few slow queries do not leave the other threads idle. Every worker owns its Session, whose
+// generation-stamped workspace is reused across queries without an O(V) reset.
+// Blank lines and lines starting with '#' are skipped. --landmarks, --landmark-select, --cache
+// and --cache-bucket are as for the server; the cache's hit rate is printed on stderr at the end.
+// Built with ROUTE_STATS, the load and the totals over all queries are printed as JSON stats
+// lines on stderr, and --stats writes one line per query, in input order, to FILE.
+
+typedef struct {
+    _Atomic uint64_t range;  // next query in the low 32 bits, end of the slice in the high 32
+    Session session;
+    pthread_t thread;
+    long steals;
+} Worker;
+
+Service service;
+Worker *workers;
+int worker_count;
+char **queries;
+Reply *replies;
+Reply *query_stats;     // per query, with --stats
+int query_count;
+
+static uint64_t pack_range(uint32_t lo, uint32_t hi) { return ((uint64_t)hi << 32) | lo; }
+
+// Claims the next query of w's own slice, or -1 when it is empty.
+int claim(Worker *w) {
+    uint64_t r = atomic_load(&w->range);
+    for (;;) {
+        uint32_t lo = (uint32_t)r, hi = (uint32_t)(r >> 32);
+        if (lo >= hi) return -1;
+        if (atomic_compare_exchange_weak(&w->range, &r, pack_range(lo + 1, hi))) return lo;
+    }
+}
+
+// Moves the back half of some other worker's slice into w, whose own slice is empty.
+// Returns 0 once every slice is empty.
+int steal(Worker *w) {
+    int self = (int)(w - workers);
+    for (int k = 1; k < worker_count; k++) {
+        Worker *v = &workers[(self + k) % worker_count];
+        uint64_t r = atomic_load(&v->range);
+        for (;;) {
+            uint32_t lo = (uint32_t)r, hi = (uint32_t)(r >> 32);
+            if (lo >= hi) break;
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (atomic_compare_exchange_weak(&v->range, &r, pack_range(lo, mid))) {
+                atomic_store(&w->range, pack_range(mid, hi));
+                w->steals++;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+void *worker_main(void *arg) {
+    Worker *w = (Worker *)arg;
+    for (;;) {
+        int i = claim(w);
+        if (i < 0) {
+            if (!steal(w)) break;
+            continue;
+        }
+        if (service_answer(&service, &w->session, queries[i], &replies[i]) && query_stats) out_stats(&query_stats[i], "query", &stats_thread);
+    }
+    return NULL;
+}
+
+int read_queries(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return 0;
+    char line[512];
+    int cap = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        char *s = line + strspn(line, " \t\r\n");
+        if (*s == '\0' || *s == '#') continue;
+        if (query_count == cap) {
+            cap = cap ? cap * 2 : 1024;
+            queries = (char **)realloc(queries, cap * sizeof(char *));
+        }
+        queries[query_count++] = strdup(s);
+    }
+    fclose(fp);
+    return 1;
+}
+
+double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv) {
+    const char *in_path = NULL, *out_path = NULL, *stats_path = NULL;
+    int simplify = 0;
+    worker_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) worker_count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--candidates") == 0 && i + 1 < argc) service.candidates = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--algorithm") == 0 && i + 1 < argc && service_algorithm(argv[i + 1]) >= 0) service.algorithm = (Algorithm)service_algorithm(argv[++i]);
+        else if (strcmp(argv[i], "--landmarks") == 0 && i + 1 < argc) service.landmark_count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--landmark-select") == 0 && i + 1 < argc && landmark_strategy(argv[i + 1]) >= 0) service.landmark_strategy = (LandmarkStrategy)landmark_strategy(argv[++i]);
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) service.cache_mb = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--cache-bucket") == 0 && i + 1 < argc) service.cache_bucket = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--simplify") == 0) simplify = 1;
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) out_path = argv[++i];
+        else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) stats_path = argv[++i];
+        else if (!in_path && argv[i][0] != '-') in_path = argv[i];
+        else { in_path = NULL; break; }
+    }
+    if (!in_path) { fprintf(stderr, "Usage: %s [--threads N] [--candidates K] [--algorithm NAME] [--landmarks K] [--landmark-select avoid|farthest] [--cache MB] [--cache-bucket MIN] [--simplify] [--out FILE] [--stats FILE] QUERIES\n", argv[0]); return 1; }
+    if (stats_path && !STATS_ENABLED) { fprintf(stderr, "Error: --stats needs a build with ROUTE_STATS (make STATS=1)\n"); return 1; }
+    if (worker_count < 1) worker_count = 1;
+    if (!read_queries(in_path)) { fprintf(stderr, "Error: cannot read %s\n", in_path); return 1; }
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) { fprintf(stderr, "Error: cannot write %s\n", out_path); return 1; }
+
+    FILE *stats_out = stats_path ? fopen(stats_path, "w") : NULL;
+    if (stats_path && !stats_out) { fprintf(stderr, "Error: cannot write %s\n", stats_path); return 1; }
+
+    service_load(&service.graph, simplify);
+    service_init(&service);
+    stats_print(stderr, "load", &stats_thread);
+    replies = (Reply *)calloc(query_count ? query_count : 1, sizeof(Reply));
+    if (stats_out) query_stats = (Reply *)calloc(query_count ? query_count : 1, sizeof(Reply));
+    workers = (Worker *)calloc(worker_count, sizeof(Worker));
+    for (int t = 0; t < worker_count; t++) {
+        uint32_t lo = (uint32_t)((long)query_count * t / worker_count), hi = (uint32_t)((long)query_count * (t + 1) / worker_count);
+        atomic_init(&workers[t].range, pack_range(lo, hi));
+        session_init(&workers[t].session, &service);
+    }
+
+    double t0 = now_sec();
+    for (int t = 0; t < worker_count; t++) pthread_create(&workers[t].thread, NULL, worker_main, &workers[t]);
+    long steals = 0;
+    for (int t = 0; t < worker_count; t++) {
+        pthread_join(workers[t].thread, NULL);
+        steals += workers[t].steals;
+    }
+    double elapsed = now_sec() - t0;
+
+    for (int i = 0; i < query_count; i++) fwrite(replies[i].buf, 1, replies[i].len, out);
+    if (out != stdout) fclose(out);
+    if (stats_out) {
+        for (int i = 0; i < query_count; i++) fwrite(query_stats[i].buf, 1, query_stats[i].len, stats_out);
+        fclose(stats_out);
+    }
+    fprintf(stderr, "%d queries on %d threads in %.3f s: %.0f queries/s (%ld steals)\n",
+            query_count, worker_count, elapsed, elapsed > 0 ? query_count / elapsed : 0.0, steals);
+    stats_print(stderr, "total", &service_stats);
+    if (service.cache) {
+        Reply r = {0};
+        service_cache_report(service.cache, &r, "Cache: ", "\n");
+        fwrite(r.buf, 1, r.len, stderr);
+        free(r.buf);
+    }
+
+    for (int t = 0; t < worker_count; t++) session_free(&workers[t].session);
+    for (int i = 0; i < query_count; i++) { free(replies[i].buf); free(queries[i]); if (query_stats) free(query_stats[i].buf); }
+    free(workers); free(replies); free(queries); free(query_stats);
+    service_free(&service);
+    return 0;
+}
@@ -0,0 +1,769 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "node_grid.h"
+#include "graph.h"
+#include "route.h"
+#include "kdtree.h"
+#include "ch.h"
+#include "transit.h"
+#include "output.h"
+#include "geo.h"
+#include "problem.h"
+
+// Offline benchmarks for the routing code. Synthetic inputs are written next to the binary.
+//   benchmark loader [vertices]   node deduplication: linear scan vs hash grid
+//   benchmark snap [vertices]     nearest-node snapping: linear scan vs k-d tree
+//   benchmark search [vertices]   cross-city car queries: Dijkstra vs A* vs bidirectional
+//   benchmark ch [vertices]       contraction hierarchy build time and query time vs Dijkstra
+//   benchmark transit [vertices]  bus + car fastest routes: per-edge Dijkstra vs RAPTOR
+//   benchmark output [vertices]   writing one long path: per-edge printf vs buffered legs
+//   benchmark geo [points]        one-to-many distances: haversine vs the batched kernels
+//   benchmark csv [vertices]      coordinate parsing: fgets/strtok/atof vs mapped parser, MB/s
+//   benchmark suite [vertices] [queries] [file]
+//                                 synthetic city in the contest CSV format, replayed through the
+//                                 solvers of problems 1, 3, 5 and 6; one JSON line per objective
+//                                 (load time, latency percentiles, settled nodes, peak RSS) is
+//                                 appended to file, benchmark_suite.json by default
+//   benchmark alt [vertices] [queries]
+//                                 the same city through the cost, time and deadline solvers with
+//                                 0-32 ALT landmarks of each strategy: build time, table memory,
+//                                 query time, settled labels and speedup over no landmarks, and
+//                                 how many answers differ from the search without landmarks
+
+#define LINEAR_CAP 20000 // the O(N^2) scan is only timed on a prefix of this many vertices
+
+double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Square street grid around Dhaka in Roadmap-Dhaka.csv format, split into short lines.
+int write_synthetic_roadmap(const char *path, int vertices) {
+    int side = (int)sqrt((double)vertices);
+    FILE *fp = fopen(path, "w");
+    if (!fp) { printf("Error: cannot write %s\n", path); return 0; }
+    for (int dir = 0; dir < 2; dir++) {
+        for (int r = 0; r < side; r++) {
+            for (int c0 = 0; c0 < side - 1; c0 += 10) {
+                fprintf(fp, "DhakaStreet");
+                for (int c = c0; c <= c0 + 10 && c < side; c++) {
+                    int y = dir ? c : r, x = dir ? r : c;
+                    fprintf(fp, ",%.6f,%.6f", 90.30 + x * 0.0001, 23.70 + y * 0.0001);
+                }
+                fprintf(fp, ",0,0.1\n");
+            }
+        }
+    }
+    fclose(fp);
+    return side * side;
+}
+
+// Minimal copy of the solvers' dedup loop; only node ids are produced.
+typedef struct { double lat, lon; } Point;
+
+Point *bench_nodes;
+int bench_count;
+NodeGrid bench_grid;
+
+int linear_node_id(double lat, double lon) {
+    for (int i = 0; i < bench_count; i++)
+        if (fabs(bench_nodes[i].lat - lat) < 1e-7 && fabs(bench_nodes[i].lon - lon) < 1e-7) return i;
+    bench_nodes[bench_count].lat = lat; bench_nodes[bench_count].lon = lon;
+    return bench_count++;
+}
+
+int grid_node_id(double lat, double lon) {
+    int id = grid_find(&bench_grid, lat, lon);
+    if (id >= 0) return id;
+    grid_insert(&bench_grid, lat, lon, bench_count);
+    bench_nodes[bench_count].lat = lat; bench_nodes[bench_count].lon = lon;
+    return bench_count++;
+}
+
+// Parses the roadmap the way load_roadmap does, stopping once max_nodes vertices exist.
+// Returns the wall time in seconds, or -1 if the file cannot be opened.
+double time_load(const char *path, int (*node_id)(double, double), int max_nodes, long *segments) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -1;
+    char line[4096];
+    double t0 = now_sec();
+    *segments = 0;
+    while (bench_count < max_nodes && fgets(line, sizeof(line), fp)) {
+        char *token = strtok(line, ",");
+        double coords[100]; int c = 0;
+        while ((token = strtok(NULL, ",")) != NULL && c < 100) coords[c++] = atof(token);
+        for (int i = 0; i < c - 4; i += 2) {
+            node_id(coords[i+1], coords[i]);
+            node_id(coords[i+3], coords[i+2]);
+            (*segments)++;
+        }
+    }
+    double t = now_sec() - t0;
+    fclose(fp);
+    return t;
+}
+
+void bench_loader(int vertices) {
+    const char *path = "bench_roadmap.csv";
+    int total = write_synthetic_roadmap(path, vertices);
+    if (!total) return;
+    bench_nodes = (Point *)malloc((size_t)total * sizeof(Point));
+    int prefix = total < LINEAR_CAP ? total : LINEAR_CAP;
+    long segs;
+
+    bench_count = 0;
+    double lin = time_load(path, linear_node_id, prefix, &segs);
+    int lin_nodes = bench_count;
+
+    bench_count = 0; grid_free(&bench_grid);
+    double grd = time_load(path, grid_node_id, prefix, &segs);
+    printf("loader prefix: %d vertices, linear %.3f s, grid %.3f s, speedup %.1fx\n", lin_nodes, lin, grd, lin / grd);
+
+    bench_count = 0; grid_free(&bench_grid);
+    double full = time_load(path, grid_node_id, total + 1, &segs);
+    printf("loader full:   %d vertices, %ld segments, grid %.3f s (%.0f segments/s)\n", bench_count, segs, full, segs / full);
+    printf("linear scan extrapolated to full file: ~%.0f s\n", lin * ((double)bench_count / lin_nodes) * ((double)bench_count / lin_nodes));
+
+    grid_free(&bench_grid);
+    free(bench_nodes);
+    remove(path);
+}
+
+// Builds the synthetic street grid as a car-only graph. Returns 0 if it cannot be written.
+int load_synthetic_graph(Graph *g, int vertices) {
+    const char *path = "bench_roadmap.csv";
+    memset(g, 0, sizeof(*g));
+    if (!write_synthetic_roadmap(path, vertices)) return 0;
+    graph_load_roads(g, path, graph_add_mode(g, "Car", 20.0, 30.0, 0, 0, 24));
+    graph_build(g);
+    remove(path);
+    return 1;
+}
+
+void bench_snap(int vertices) {
+    Graph g;
+    if (!load_synthetic_graph(&g, vertices)) return;
+
+    double t0 = now_sec();
+    KdTree t;
+    kd_build(&t, &g, NULL);
+    double build = now_sec() - t0;
+
+    // Query points spread a little beyond the grid so some snaps land on its edges
+    int queries = 2000;
+    double span = sqrt((double)vertices) * 0.0001;
+    double *lat = (double *)malloc(queries * sizeof(double)), *lon = (double *)malloc(queries * sizeof(double));
+    srand(7);
+    for (int i = 0; i < queries; i++) {
+        lat[i] = 23.70 + (rand() / (double)RAND_MAX * 1.1 - 0.05) * span;
+        lon[i] = 90.30 + (rand() / (double)RAND_MAX * 1.1 - 0.05) * span;
+    }
+    int *lin_ids = (int *)malloc(queries * sizeof(int)), mismatches = 0;
+    t0 = now_sec();
+    for (int i = 0; i < queries; i++) lin_ids[i] = route_nearest(&g, NULL, ~0u, lat[i], lon[i], NULL);
+    double lin = now_sec() - t0;
+    t0 = now_sec();
+    for (int i = 0; i < queries; i++) if (kd_nearest(&t, ~0u, lat[i], lon[i], NULL) != lin_ids[i]) mismatches++;
+    double kd = now_sec() - t0;
+
+    printf("snap: %d nodes, k-d build %.3f s\n", g.node_count, build);
+    printf("snap: %d queries, linear %.3f ms/query, k-d %.4f ms/query, speedup %.0fx, %d mismatches\n",
+           queries, lin * 1e3 / queries, kd * 1e3 / queries, lin / kd, mismatches);
+    free(lat); free(lon); free(lin_ids);
+    kd_free(&t);
+    graph_free(&g);
+}
+
+void bench_search(int vertices) {
+    Graph g;
+    if (!load_synthetic_graph(&g, vertices)) return;
+    graph_build_reverse(&g);
+    Workspace ws;
+    workspace_init(&ws, g.node_count);
+
+    // West-to-east trips across the middle of the grid
+    int queries = 200, side = (int)sqrt((double)vertices);
+    int *src = (int *)malloc(queries * sizeof(int)), *dst = (int *)malloc(queries * sizeof(int));
+    double *ref = (double *)malloc(queries * sizeof(double));
+    KdTree t;
+    kd_build(&t, &g, NULL);
+    srand(11);
+    for (int i = 0; i < queries; i++) {
+        int y1 = side * 3 / 8 + rand() % (side / 4), y2 = side * 3 / 8 + rand() % (side / 4);
+        src[i] = kd_nearest(&t, ~0u, 23.70 + y1 * 0.0001, 90.30 + (side / 8 + rand() % (side / 8)) * 0.0001, NULL);
+        dst[i] = kd_nearest(&t, ~0u, 23.70 + y2 * 0.0001, 90.30 + (side * 3 / 4 + rand() % (side / 8)) * 0.0001, NULL);
+    }
+    kd_free(&t);
+    const char *names[] = {"dijkstra", "astar", "bidir"};
+    for (int a = 0; a < 3; a++) {
+        long settled = 0; int mismatches = 0;
+        double t0 = now_sec();
+        for (int i = 0; i < queries; i++) {
+            Query q = { src[i], dst[i], 9 * 60.0, INF, OBJ_DISTANCE, ~0u };
+            q.algorithm = (Algorithm)a;
+            double d = route_search(&g, g.modes, &ws, &q) ? ws.key[ws.target] : INF;
+            if (a == 0) ref[i] = d;
+            else if (fabs(d - ref[i]) > 1e-9) mismatches++;
+            settled += ws.settled;
+        }
+        double t = now_sec() - t0;
+        printf("search %-8s %d queries, %.3f ms/query, %ld settled/query, %d mismatches\n",
+               names[a], queries, t * 1e3 / queries, settled / queries, mismatches);
+    }
+    free(src); free(dst); free(ref);
+    workspace_free(&ws);
+    graph_free(&g);
+}
+
+void bench_ch(int vertices) {
+    Graph g;
+    if (!load_synthetic_graph(&g, vertices)) return;
+    double t0 = now_sec();
+    ContractionHierarchy ch;
+    ch_build(&ch, &g, 1u);
+    printf("ch build: %d nodes, %d edges, %d shortcuts, %.2f s\n", g.node_count, g.edge_count, ch.arc_count - g.edge_count, now_sec() - t0);
+
+    Workspace ws;
+    workspace_init(&ws, g.node_count);
+    int queries = 1000, mismatches = 0;
+    int *src = (int *)malloc(queries * sizeof(int)), *dst = (int *)malloc(queries * sizeof(int));
+    double *ref = (double *)malloc(queries * sizeof(double));
+    srand(13);
+    for (int i = 0; i < queries; i++) { src[i] = rand() % g.node_count; dst[i] = rand() % g.node_count; }
+    long settled = 0;
+    t0 = now_sec();
+    for (int i = 0; i < queries; i++) {
+        Query q = { src[i], dst[i], 9 * 60.0, INF, OBJ_DISTANCE, ~0u };
+        ref[i] = route_search(&g, g.modes, &ws, &q) ? ws.key[ws.target] : INF;
+        settled += ws.settled;
+    }
+    double dij = now_sec() - t0;
+    printf("ch dijkstra: %.3f ms/query, %ld settled/query\n", dij * 1e3 / queries, settled / queries);
+    settled = 0;
+    t0 = now_sec();
+    for (int i = 0; i < queries; i++) {
+        Query q = { src[i], dst[i], 9 * 60.0, INF, OBJ_DISTANCE, ~0u };
+        double d = ch_search(&ch, &g, g.modes, &ws, &q) ? ws.key[ws.target] : INF;
+        if (fabs(d - ref[i]) > 1e-9) mismatches++;
+        settled += ws.settled;
+    }
+    double hier = now_sec() - t0;
+    printf("ch query:    %.1f us/query incl. unpacking, %ld settled/query, speedup %.0fx, %d mismatches\n",
+           hier * 1e6 / queries, settled / queries, dij / hier, mismatches);
+    free(src); free(dst); free(ref);
+    workspace_free(&ws);
+    ch_free(&ch);
+    graph_free(&g);
+}
+
+// Transit lines along every `every`th row and column of the synthetic grid from `first`,
+// stopping at every `stop`th vertex, both ways, in Routemap-*.csv format and split into 50-stop
+// lines like the real route files. Stops are grid vertices, so riders change to roads there.
+int write_transit_lines(const char *path, int vertices, const char *name, int every, int first, int stop) {
+    int side = (int)sqrt((double)vertices);
+    FILE *fp = fopen(path, "w");
+    if (!fp) { printf("Error: cannot write %s\n", path); return 0; }
+    for (int dir = 0; dir < 4; dir++)
+        for (int r = first; r < side; r += every)
+            for (int c0 = 0; c0 < side - 1; c0 += 50 * stop) {
+                fprintf(fp, "%s", name);
+                for (int c = c0; c <= c0 + 50 * stop && c < side; c += stop) {
+                    int along = dir & 1 ? side - 1 - c : c;
+                    int y = dir & 2 ? along : r, x = dir & 2 ? r : along;
+                    fprintf(fp, ",%.6f,%.6f", 90.30 + x * 0.0001, 23.70 + y * 0.0001);
+                }
+                fprintf(fp, ",Start,End\n");
+            }
+    fclose(fp);
+    return 1;
+}
+
+// Bus lines along every 20th row and column, stopping everywhere.
+int write_synthetic_routemap(const char *path, int vertices) {
+    return write_transit_lines(path, vertices, "BenchBus", 20, 0, 1);
+}
+
+void bench_transit(int vertices) {
+    const char *roads = "bench_roadmap.csv", *routes = "bench_routemap.csv";
+    Graph g;
+    memset(&g, 0, sizeof(g));
+    if (!write_synthetic_roadmap(roads, vertices) || !write_synthetic_routemap(routes, vertices)) return;
+    // Problem 5's slow cars, with buses three times as fast every 10 minutes
+    graph_load_roads(&g, roads, graph_add_mode(&g, "Car", 20.0, 10.0, 0, 0, 24));
+    graph_load_routes(&g, routes, graph_add_mode(&g, "Bus", 7.0, 30.0, 10.0, 6, 22));
+    graph_build(&g);
+    remove(roads); remove(routes);
+    double t0 = now_sec();
+    Timetable tt;
+    timetable_build(&tt, &g, 1u << 1);
+    printf("transit: %d nodes, %d edges, %d routes, %d stops, timetable %.3f s\n",
+           g.node_count, g.edge_count, tt.route_count, tt.slot_count, now_sec() - t0);
+
+    Workspace ws;
+    RaptorWorkspace rw;
+    workspace_init(&ws, g.node_count);
+    raptor_init(&rw, &tt, g.node_count);
+    int queries = 200, earlier = 0;
+    int *src = (int *)malloc(queries * sizeof(int)), *dst = (int *)malloc(queries * sizeof(int));
+    double *ref = (double *)malloc(queries * sizeof(double));
+    srand(17);
+    for (int i = 0; i < queries; i++) { src[i] = rand() % g.node_count; dst[i] = rand() % g.node_count; }
+    long settled = 0;
+    t0 = now_sec();
+    for (int i = 0; i < queries; i++) {
+        Query q = { src[i], dst[i], 8 * 60.0, INF, OBJ_TIME, ~0u };
+        ref[i] = route_search(&g, g.modes, &ws, &q) ? ws.time_at[ws.target] : INF;
+        settled += ws.settled;
+    }
+    double dij = now_sec() - t0;
+    printf("transit dijkstra: %.3f ms/query, %ld settled/query (waits on every bus segment)\n", dij * 1e3 / queries, settled / queries);
+    settled = 0;
+    t0 = now_sec();
+    for (int i = 0; i < queries; i++) {
+        Query q = { src[i], dst[i], 8 * 60.0, INF, OBJ_TIME, ~0u };
+        double t = raptor_search(&g, g.modes, &tt, &ws, &rw, &q) ? ws.time_at[ws.target] : INF;
+        if (t < ref[i] - 1e-9) earlier++;
+        settled += ws.settled;
+    }
+    double rap = now_sec() - t0;
+    printf("transit raptor:   %.3f ms/query, %ld nodes+stops/query, speedup %.1fx, earlier arrival on %d of %d\n",
+           rap * 1e3 / queries, settled / queries, dij / rap, earlier, queries);
+    free(src); free(dst); free(ref);
+    raptor_free(&rw);
+    workspace_free(&ws);
+    timetable_free(&tt);
+    graph_free(&g);
+}
+
+// The directions text the solvers used to print, one edge search and printf per step.
+void directions_printf(OutBuf *o, const Graph *g, const Workspace *ws, const int *path, int count, double start_time) {
+    char t1[20], t2[20];
+    const Coord *a = &g->nodes[path[0]];
+    format_time(start_time, t1); format_time(ws->time_at[path[0]], t2);
+    out_printf(o, "%s - %s, Cost: BDT 0.00: Walk from Source (%f, %f) to (%f, %f).\n\n", t1, t2, a->lon, a->lat, a->lon, a->lat);
+    for (int i = 1; i < count; i++) {
+        int u = path[i-1], v = path[i], e = graph_find_edge(g, u, v);
+        const Mode *m = &g->modes[g->mode[e]];
+        format_time(ws->time_at[u], t1); format_time(ws->time_at[v], t2);
+        out_printf(o, "%s - %s, Cost: BDT %.2f: Ride %s from (%f, %f) to (%f, %f).\n\n", t1, t2, g->dist[e] * m->cost_rate, m->name,
+                   g->nodes[u].lon, g->nodes[u].lat, g->nodes[v].lon, g->nodes[v].lat);
+    }
+    a = &g->nodes[path[count - 1]];
+    format_time(ws->time_at[path[count - 1]], t1);
+    out_printf(o, "%s - %s, Cost: BDT 0.00: Walk from (%f, %f) to Destination (%f, %f).\n", t1, t1, a->lon, a->lat, a->lon, a->lat);
+}
+
+void bench_output(int vertices) {
+    Graph g;
+    if (!load_synthetic_graph(&g, vertices)) return;
+    Workspace ws;
+    workspace_init(&ws, g.node_count);
+    KdTree t;
+    kd_build(&t, &g, NULL);
+    int side = (int)sqrt((double)vertices);
+    Query q = { kd_nearest(&t, ~0u, 23.70, 90.30, NULL), kd_nearest(&t, ~0u, 23.70 + side * 0.0001, 90.30 + side * 0.0001, NULL), 9 * 60.0, INF, OBJ_DISTANCE, ~0u };
+    kd_free(&t);
+    if (!route_search(&g, g.modes, &ws, &q)) { printf("output: no path\n"); workspace_free(&ws); graph_free(&g); return; }
+    int *path = (int *)malloc(g.node_count * sizeof(int)), count = route_path(&ws, ws.target, path);
+    const Coord *a = &g.nodes[path[0]], *b = &g.nodes[path[count - 1]];
+
+    int reps = 200;
+    OutBuf o1 = {0}, o2 = {0};
+    double t0 = now_sec();
+    for (int r = 0; r < reps; r++) { o1.len = 0; directions_printf(&o1, &g, &ws, path, count, 9 * 60.0); }
+    double old = now_sec() - t0;
+    PathResult pr = {0};
+    t0 = now_sec();
+    for (int r = 0; r < reps; r++) {
+        o2.len = 0;
+        path_build(&pr, &g, g.modes, &ws, ws.target, 0);
+        path_set_ends(&pr, a->lat, a->lon, b->lat, b->lon, 9 * 60.0, 0);
+        path_write_directions(&o2, &g, g.modes, &pr);
+    }
+    double buf = now_sec() - t0;
+    size_t text = o2.len;
+    t0 = now_sec();
+    for (int r = 0; r < reps; r++) {
+        o2.len = 0;
+        path_build(&pr, &g, g.modes, &ws, ws.target, 0);
+        path_set_ends(&pr, a->lat, a->lon, b->lat, b->lon, 9 * 60.0, 0);
+        path_write_directions(&o2, &g, g.modes, &pr);
+        path_write_kml(&o2, &g, &pr);
+        path_write_geojson(&o2, &g, g.modes, &pr);
+    }
+    double all = now_sec() - t0;
+    printf("output: %d-node path in %d leg%s\n", count, pr.leg_count, pr.leg_count == 1 ? "" : "s");
+    printf("output printf:  %.1f us/path (directions only, one line per edge, %zu bytes)\n", old * 1e6 / reps, o1.len);
+    printf("output buffer:  %.1f us/path (directions only, one line per leg, %zu bytes), speedup %.1fx\n", buf * 1e6 / reps, text, old / buf);
+    printf("output buffer:  %.1f us/path for directions + KML + GeoJSON, %zu bytes\n", all * 1e6 / reps, o2.len);
+    out_free(&o1); out_free(&o2); path_free(&pr); free(path);
+    workspace_free(&ws);
+    graph_free(&g);
+}
+
+// Times one kernel over every query and returns the largest error against ref, in km.
+double bench_geo_kernel(const char *name, GeoKernel k, const GeoPoints *p, const double *qlat, const double *qlon, int queries,
+                        const double *ref, double *out, double base, double *max_rel) {
+    double t0 = now_sec();
+    for (int j = 0; j < queries; j++) geo_distances_with(k, p, 0, p->count, qlat[j], qlon[j], out + (size_t)j * p->count);
+    double elapsed = now_sec() - t0, max_abs = 0;
+    *max_rel = 0;
+    for (size_t i = 0; i < (size_t)queries * p->count; i++) {
+        double e = fabs(out[i] - ref[i]);
+        if (e > max_abs) max_abs = e;
+        if (ref[i] > 0 && e / ref[i] > *max_rel) *max_rel = e / ref[i];
+    }
+    printf("geo %-9s %.2f ns/distance, speedup %.1fx, max error %.2e km (%.1e relative)\n",
+           name, elapsed * 1e9 / ((double)queries * p->count), base / elapsed, max_abs, *max_rel);
+    return max_abs;
+}
+
+void bench_geo(int points) {
+    int queries = 64;
+    double *lat = (double *)malloc(points * sizeof(double)), *lon = (double *)malloc(points * sizeof(double));
+    double qlat[64], qlon[64];
+    GeoPoints p;
+    geo_points_init(&p, points);
+    // City-scale points around Dhaka; the last query pairs them with points worldwide to exercise the asin fallback
+    srand(7);
+    for (int i = 0; i < points; i++) {
+        lat[i] = 23.60 + rand() / (double)RAND_MAX * 0.4;
+        lon[i] = 90.25 + rand() / (double)RAND_MAX * 0.4;
+        geo_points_set(&p, i, lat[i], lon[i]);
+    }
+    for (int j = 0; j < queries; j++) {
+        qlat[j] = j == queries - 1 ? -33.87 : 23.60 + rand() / (double)RAND_MAX * 0.4;
+        qlon[j] = j == queries - 1 ? 151.21 : 90.25 + rand() / (double)RAND_MAX * 0.4;
+    }
+    size_t cells = (size_t)queries * points;
+    double *ref = (double *)malloc(cells * sizeof(double)), *out = (double *)malloc(cells * sizeof(double));
+    double *first = (double *)malloc(cells * sizeof(double));
+
+    double t0 = now_sec();
+    for (int j = 0; j < queries; j++)
+        for (int i = 0; i < points; i++) ref[(size_t)j * points + i] = haversine(qlat[j], qlon[j], lat[i], lon[i]);
+    double base = now_sec() - t0;
+    printf("geo: %d queries x %d points\n", queries, points);
+    printf("geo haversine %.2f ns/distance\n", base * 1e9 / cells);
+
+    GeoKernel kernels[3] = { geo_kernel_scalar, NULL, NULL };
+    const char *names[3] = { "scalar", "sse2", "avx2" };
+#ifdef GEO_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) kernels[1] = geo_kernel_sse2;
+    if (__builtin_cpu_supports("avx2")) kernels[2] = geo_kernel_avx2;
+#endif
+    double worst = 0, rel;
+    int differ = 0;
+    for (int k = 0; k < 3; k++) {
+        if (!kernels[k]) { printf("geo %-9s not supported here\n", names[k]); continue; }
+        double e = bench_geo_kernel(names[k], kernels[k], &p, qlat, qlon, queries, ref, k ? out : first, base, &rel);
+        if (e > worst) worst = e;
+        if (k && memcmp(out, first, cells * sizeof(double)) != 0) differ++;
+    }
+    printf("geo: kernels %s bit for bit, worst error %.2e km, selected %s\n", differ ? "differ" : "agree", worst,
+           geo_kernel() == kernels[2] ? "avx2" : geo_kernel() == kernels[1] ? "sse2" : "scalar");
+    free(lat); free(lon); free(ref); free(out); free(first);
+    geo_points_free(&p);
+}
+
+// Routemap-style lines of 500 stops each, far longer than the old 8000-byte line buffer.
+int write_long_routemap(const char *path, int vertices) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) { printf("Error: cannot write %s\n", path); return 0; }
+    srand(11);
+    for (int v = 0; v < vertices; v += 500) {
+        fprintf(fp, "DhakaBusBench");
+        for (int i = 0; i < 500; i++) fprintf(fp, ",%.6f,%.6f", 90.30 + rand() % 4000 * 0.0001, 23.70 + rand() % 4000 * 0.0001);
+        fprintf(fp, ",Start,End\n");
+    }
+    fclose(fp);
+    return 1;
+}
+
+typedef struct {
+    const CsvFile *f;
+    size_t from, to;
+    long values;
+    double sum;
+} CsvPart;
+
+void *csv_part_main(void *arg) {
+    CsvPart *part = (CsvPart *)arg;
+    CsvCursor cur = csv_cursor(part->f, part->from, part->to);
+    const char *b, *e;
+    double *vals = NULL; int cap = 0;
+    while (csv_line(&cur, &b, &e)) {
+        int n = csv_numbers(b, e, &vals, &cap);
+        for (int i = 0; i < n; i++) part->sum += vals[i];
+        part->values += n;
+    }
+    free(vals);
+    return NULL;
+}
+
+// Numbers parsed from path by the old loaders' loop: fixed line buffer, strtok, atof, stopping
+// at the first field that is not a number as csv_numbers does.
+double csv_old(const char *path, long *values) {
+    FILE *fp = fopen(path, "r");
+    char line[8000], *token, *stop;
+    double sum = 0;
+    *values = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        strtok(line, ",");
+        while ((token = strtok(NULL, ",\n")) != NULL) {
+            double v = atof(token);
+            strtod(token, &stop);
+            if (stop == token || *stop) break;
+            sum += v; (*values)++;
+        }
+    }
+    fclose(fp);
+    return sum;
+}
+
+void bench_csv_file(const char *name, const char *path, int threads) {
+    CsvFile f;
+    if (!csv_open(&f, path)) { printf("Error: cannot map %s\n", path); return; }
+    double mb = f.size / 1e6;
+    long old_values;
+    double t0 = now_sec();
+    double old_sum = csv_old(path, &old_values);
+    double old = now_sec() - t0;
+
+    CsvPart parts[64];
+    size_t starts[65];
+    double times[2];
+    long values = 0;
+    double sum = 0;
+    for (int run = 0; run < 2; run++) {
+        int n = run ? threads : 1;
+        csv_split(&f, n, starts);
+        t0 = now_sec();
+        pthread_t tid[64];
+        for (int i = 0; i < n; i++) {
+            parts[i] = (CsvPart){ &f, starts[i], starts[i+1], 0, 0 };
+            pthread_create(&tid[i], NULL, csv_part_main, &parts[i]);
+        }
+        for (int i = 0; i < n; i++) pthread_join(tid[i], NULL);
+        times[run] = now_sec() - t0;
+        if (!run) for (int i = 0; i < n; i++) { values += parts[i].values; sum += parts[i].sum; }
+    }
+    printf("csv %s: %.1f MB, %ld numbers; fgets/strtok read %ld, %s\n", name, mb, values, old_values,
+           old_values == values && old_sum == sum ? "identical" : "some lost or split at the line buffer");
+    printf("csv %s: fgets/strtok/atof %.0f MB/s, mapped %.0f MB/s (%.1fx), %d threads %.0f MB/s (%.1fx)\n",
+           name, mb / old, mb / times[0], old / times[0], threads, mb / times[1], old / times[1]);
+    csv_close(&f);
+}
+
+void bench_csv(int vertices) {
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > 64) threads = 64;
+    if (threads < 1) threads = 1;
+    if (write_synthetic_roadmap("bench_roadmap.csv", vertices)) bench_csv_file("roadmap", "bench_roadmap.csv", threads);
+    if (write_long_routemap("bench_routemap.csv", vertices)) bench_csv_file("routemap", "bench_routemap.csv", threads);
+    remove("bench_roadmap.csv"); remove("bench_routemap.csv");
+}
+
+#define SUITE_DIR "bench_city"
+
+// The four contest CSVs for a city of about `vertices` street corners: the street grid, metro
+// lines every 100 streets with a station every 10 corners, and two bus networks on alternate
+// 20-street spacings.
+int write_synthetic_city(int vertices) {
+    return write_synthetic_roadmap("Roadmap-Dhaka.csv", vertices)
+        && write_transit_lines("Routemap-DhakaMetroRail.csv", vertices, "BenchMetro", 100, 50, 10)
+        && write_transit_lines("Routemap-BikolpoBus.csv", vertices, "BenchBikolpo", 20, 0, 2)
+        && write_transit_lines("Routemap-UttaraBus.csv", vertices, "BenchUttara", 20, 10, 2);
+}
+
+int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Nearest-rank percentile of sorted v.
+double percentile(const double *v, int n, double p) {
+    int i = (int)ceil(p * n) - 1;
+    return v[i < 0 ? 0 : i];
+}
+
+// Loads problem `id` from the CSVs in the working directory, replays the queries and appends
+// one JSON line to out. Runs in its own process so peak RSS is this objective's alone.
+void suite_run(FILE *out, int id, int vertices, int queries, const double *q) {
+    static const char *objectives[] = {"distance", "cost", "time"};
+    Problem p;
+    problem_init(&p, id);
+    double t0 = now_sec();
+    problem_load(&p);
+    double load = now_sec() - t0;
+    const ProblemSpec *spec = p.spec;
+    double *ms = (double *)malloc(queries * sizeof(double));
+    long settled = 0, settled_max = 0;
+    int found = 0;
+    PathResult pr = {0};
+    for (int i = 0; i < queries; i++) {
+        const double *qi = q + 5 * i;
+        double start = spec->start_time >= 0 ? spec->start_time : qi[4];
+        t0 = now_sec();
+        found += problem_solve(&p, qi[0], qi[1], qi[2], qi[3], start, spec->needs_deadline ? start + 180 : INF, &pr);
+        ms[i] = (now_sec() - t0) * 1e3;
+        settled += p.ws.settled;
+        if (p.ws.settled > settled_max) settled_max = p.ws.settled;
+    }
+    double total = 0;
+    for (int i = 0; i < queries; i++) total += ms[i];
+    qsort(ms, queries, sizeof(double), cmp_double);
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    const char *objective = spec->needs_deadline ? "cost_deadline" : objectives[spec->objective];
+    printf("suite %-13s problem %d: load %.2f s, %d/%d found, p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms, %ld settled/query, peak RSS %.0f MB\n",
+           objective, id, load, found, queries, percentile(ms, queries, 0.5), percentile(ms, queries, 0.9), percentile(ms, queries, 0.99),
+           ms[queries - 1], settled / queries, ru.ru_maxrss / 1024.0);
+    fprintf(out, "{\"benchmark\":\"suite\",\"objective\":\"%s\",\"problem\":%d,\"vertices\":%d,\"nodes\":%d,\"edges\":%d,"
+                 "\"queries\":%d,\"found\":%d,\"load_s\":%.4f,\"mean_ms\":%.4f,\"p50_ms\":%.4f,\"p90_ms\":%.4f,\"p99_ms\":%.4f,"
+                 "\"max_ms\":%.4f,\"settled_mean\":%ld,\"settled_max\":%ld,\"peak_rss_kb\":%ld}\n",
+            objective, id, vertices, p.graph.node_count, p.graph.edge_count, queries, found, load, total / queries,
+            percentile(ms, queries, 0.5), percentile(ms, queries, 0.9), percentile(ms, queries, 0.99), ms[queries - 1],
+            settled / queries, settled_max, ru.ru_maxrss);
+    path_free(&pr); free(ms);
+    problem_free(&p);
+}
+
+void bench_suite(int vertices, int queries, const char *path) {
+    if (queries < 1) queries = 1;
+    FILE *out = fopen(path, "a");
+    if (!out) { printf("Error: cannot write %s\n", path); return; }
+    mkdir(SUITE_DIR, 0755);
+    if (chdir(SUITE_DIR) != 0) { printf("Error: cannot enter %s\n", SUITE_DIR); fclose(out); return; }
+    double t0 = now_sec();
+    if (!write_synthetic_city(vertices)) { fclose(out); return; }
+    printf("suite: %d vertices written in %.2f s, %d queries per objective\n", vertices, now_sec() - t0, queries);
+
+    // The same trips for every objective: two points anywhere in the city and a departure between 6 AM and 9 PM
+    double span = sqrt((double)vertices) * 0.0001, *q = (double *)malloc(queries * 5 * sizeof(double));
+    srand(23);
+    for (int i = 0; i < queries; i++) {
+        double *qi = q + 5 * i;
+        qi[0] = 23.70 + rand() / (double)RAND_MAX * span; qi[1] = 90.30 + rand() / (double)RAND_MAX * span;
+        qi[2] = 23.70 + rand() / (double)RAND_MAX * span; qi[3] = 90.30 + rand() / (double)RAND_MAX * span;
+        qi[4] = 6 * 60 + rand() % (15 * 60);
+    }
+    const int ids[] = {1, 3, 5, 6};
+    for (int k = 0; k < 4; k++) {
+        fflush(stdout); fflush(out);
+        pid_t pid = fork();
+        if (pid == 0) {
+            suite_run(out, ids[k], vertices, queries, q);
+            fflush(stdout); fflush(out);
+            _exit(0);
+        }
+        int status;
+        if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status))
+            printf("suite problem %d: failed\n", ids[k]);
+    }
+    free(q);
+    fclose(out);
+    remove("Roadmap-Dhaka.csv"); remove("Routemap-DhakaMetroRail.csv");
+    remove("Routemap-BikolpoBus.csv"); remove("Routemap-UttaraBus.csv");
+    if (chdir("..") == 0) rmdir(SUITE_DIR);
+    printf("suite: results appended to %s\n", path);
+}
+
+#define ALT_DIR "bench_alt"
+
+// Replays q through p's solver; returns the total seconds and fills the objective value (INF when
+// not found) and settled count of each query.
+double alt_run(Problem *p, int queries, const double *q, double *value, long *settled) {
+    PathResult pr = {0};
+    double total = 0;
+    for (int i = 0; i < queries; i++) {
+        const double *qi = q + 5 * i;
+        double start = p->spec->start_time >= 0 ? p->spec->start_time : qi[4];
+        double t0 = now_sec();
+        int found = problem_solve(p, qi[0], qi[1], qi[2], qi[3], start, p->spec->needs_deadline ? start + 180 : INF, &pr);
+        total += now_sec() - t0;
+        value[i] = found ? p->ws.key[p->ws.target] : INF;
+        settled[i] = p->ws.settled;
+    }
+    path_free(&pr);
+    return total;
+}
+
+void bench_alt(int vertices, int queries) {
+    if (queries < 1) queries = 1;
+    mkdir(ALT_DIR, 0755);
+    if (chdir(ALT_DIR) != 0) { printf("Error: cannot enter %s\n", ALT_DIR); return; }
+    if (!write_synthetic_city(vertices)) return;
+    double span = sqrt((double)vertices) * 0.0001, *q = (double *)malloc(queries * 5 * sizeof(double));
+    srand(24);
+    for (int i = 0; i < queries; i++) {
+        double *qi = q + 5 * i;
+        qi[0] = 23.70 + rand() / (double)RAND_MAX * span; qi[1] = 90.30 + rand() / (double)RAND_MAX * span;
+        qi[2] = 23.70 + rand() / (double)RAND_MAX * span; qi[3] = 90.30 + rand() / (double)RAND_MAX * span;
+        qi[4] = 6 * 60 + rand() % (15 * 60);
+    }
+    double *ref = (double *)malloc(queries * sizeof(double)), *value = (double *)malloc(queries * sizeof(double));
+    long *settled = (long *)malloc(queries * sizeof(long));
+    const int ids[] = {3, 5, 6}, counts[] = {1, 2, 4, 8, 16, 32};
+    for (int k = 0; k < 3; k++) {
+        Problem p;
+        problem_init(&p, ids[k]);
+        problem_load(&p);
+        double base = alt_run(&p, queries, q, ref, settled), base_settled = 0;
+        for (int i = 0; i < queries; i++) base_settled += settled[i];
+        printf("alt problem %d (%d nodes): no landmarks %.3f ms/query, %.0f settled/query\n",
+               ids[k], p.graph.node_count, base * 1e3 / queries, base_settled / queries);
+        for (int s = 0; s < 2; s++)
+            for (int c = 0; c < 6; c++) {
+                Landmarks lm;
+                double t0 = now_sec();
+                problem_landmarks(&p, &lm, counts[c], (LandmarkStrategy)s);
+                double build = now_sec() - t0, t = alt_run(&p, queries, q, value, settled), total_settled = 0;
+                int differ = 0, worse = 0;
+                for (int i = 0; i < queries; i++) {
+                    total_settled += settled[i];
+                    if (fabs(value[i] - ref[i]) > 1e-6 * (1 + fabs(ref[i]))) { differ++; worse += value[i] > ref[i]; }
+                }
+                printf("alt problem %d %-8s %2d landmarks: build %.2f s, %.1f MB, %.3f ms/query, %.0f settled/query, speedup %.2fx, %d differ (%d worse)\n",
+                       ids[k], landmark_strategy_names[s], lm.count, build, landmarks_bytes(&lm) / 1048576.0, t * 1e3 / queries,
+                       total_settled / queries, base / t, differ, worse);
+                p.landmarks = NULL;
+                landmarks_free(&lm);
+            }
+        problem_free(&p);
+    }
+    free(q); free(ref); free(value); free(settled);
+    remove("Roadmap-Dhaka.csv"); remove("Routemap-DhakaMetroRail.csv");
+    remove("Routemap-BikolpoBus.csv"); remove("Routemap-UttaraBus.csv");
+    if (chdir("..") == 0) rmdir(ALT_DIR);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Usage: %s loader|snap|search|ch|transit|output|geo|csv|suite|alt [vertices]\n", argv[0]);
+        return 1;
+    }
+    if (strcmp(argv[1], "loader") == 0) bench_loader(argc > 2 ? atoi(argv[2]) : 1000000);
+    else if (strcmp(argv[1], "snap") == 0) bench_snap(argc > 2 ? atoi(argv[2]) : 200000);
+    else if (strcmp(argv[1], "search") == 0) bench_search(argc > 2 ? atoi(argv[2]) : 250000);
+    else if (strcmp(argv[1], "ch") == 0) bench_ch(argc > 2 ? atoi(argv[2]) : 5000);
+    else if (strcmp(argv[1], "transit") == 0) bench_transit(argc > 2 ? atoi(argv[2]) : 250000);
+    else if (strcmp(argv[1], "output") == 0) bench_output(argc > 2 ? atoi(argv[2]) : 250000);
+    else if (strcmp(argv[1], "geo") == 0) bench_geo(argc > 2 ? atoi(argv[2]) : 100000);
+    else if (strcmp(argv[1], "csv") == 0) bench_csv(argc > 2 ? atoi(argv[2]) : 1000000);
+    else if (strcmp(argv[1], "suite") == 0)
+        bench_suite(argc > 2 ? atoi(argv[2]) : 50000, argc > 3 ? atoi(argv[3]) : 50, argc > 4 ? argv[4] : "benchmark_suite.json");
+    else if (strcmp(argv[1], "alt") == 0) bench_alt(argc > 2 ? atoi(argv[2]) : 40000, argc > 3 ? atoi(argv[3]) : 20);
+    else { printf("Unknown benchmark: %s\n", argv[1]); return 1; }
+    return 0;
+}
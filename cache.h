@@ -0,0 +1,180 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "route.h"
+
+// Result cache for the service: an LRU map from (problem, snapped entry node, snapped exit node,
+// start-time bucket, deadline bucket) to the route found for it, so a repeated trip skips the
+// search. Buckets are bucket minutes wide, or a thousandth of a minute with bucket 0, which
+// only matches the same moment. An entry keeps the path's nodes and the edges that reach them
+// (the leg list output.h rebuilds) and the trip's figures (CacheTrip), from which the caller
+// decides whether the route also answers its own departure and deadline. The problem fixes the
+// objective, fares and speeds. Entries are dropped least recently used first once their bytes pass the budget,
+// and all at once when the graph version moves on. One mutex guards the map; a lookup copies
+// the entry out, so the caller formats the reply without holding it.
+
+#define CACHE_MIN_SLOTS 1024
+
+typedef struct {
+    int problem, src, dst, start, deadline;     // buckets, -1 for a time the route ignores
+} CacheKey;
+
+// Times are minutes at the path's ends, the walks to and from the query points excluded.
+typedef struct {
+    double dist_km, cost;
+    double depart, arrive;  // leaving the first path node and reaching the last
+    double deadline;        // latest allowed arrival at the last node, INF for none
+    double slack;           // how much later the trip could leave and still board its first vehicle
+} CacheTrip;
+
+typedef struct CacheEntry {
+    struct CacheEntry *newer, *older, *chain;   // LRU list and hash chain
+    CacheKey key;
+    CacheTrip trip;
+    int count;
+    int path[];                                 // count nodes, then the edge into each
+} CacheEntry;
+
+typedef struct {
+    size_t budget, bytes;
+    int bucket;             // minutes per time bucket, 0 for exact times
+    unsigned version;       // graph version the entries belong to
+    CacheEntry **slots;
+    int slot_count, count;
+    CacheEntry *newest, *oldest;
+    long hits, misses;
+    pthread_mutex_t lock;
+} Cache;
+
+// budget bytes of entries, 0 to disable; times fall in buckets of bucket minutes, 0 for exact.
+static inline void cache_init(Cache *c, size_t budget, int bucket) {
+    memset(c, 0, sizeof(*c));
+    c->budget = budget;
+    c->bucket = bucket > 0 ? bucket : 0;
+    pthread_mutex_init(&c->lock, NULL);
+}
+
+// start and deadline are minutes, each INF when the route does not depend on it.
+static inline CacheKey cache_key(const Cache *c, int problem, int src, int dst, double start, double deadline) {
+    double unit = c->bucket > 0 ? c->bucket : 1e-3;
+    CacheKey k = { problem, src, dst, start < INF ? (int)floor(start / unit) : -1, deadline < INF ? (int)floor(deadline / unit) : -1 };
+    return k;
+}
+
+static inline unsigned cache_hash(const CacheKey *k) {
+    unsigned h = 2166136261u;
+    const int v[5] = { k->problem, k->src, k->dst, k->start, k->deadline };
+    for (int i = 0; i < 5; i++) h = (h ^ (unsigned)v[i]) * 16777619u;
+    return h ^ (h >> 15);
+}
+
+// An entry's share of the budget, its hash slot included.
+static inline size_t cache_entry_bytes(int count) { return sizeof(CacheEntry) + sizeof(CacheEntry *) + 2 * count * sizeof(int); }
+
+static inline void cache_unlink(Cache *c, CacheEntry *e) {
+    if (e->newer) e->newer->older = e->older; else c->newest = e->older;
+    if (e->older) e->older->newer = e->newer; else c->oldest = e->newer;
+}
+
+static inline void cache_push(Cache *c, CacheEntry *e) {
+    e->newer = NULL; e->older = c->newest;
+    if (c->newest) c->newest->newer = e; else c->oldest = e;
+    c->newest = e;
+}
+
+static inline void cache_drop(Cache *c, CacheEntry *e) {
+    CacheEntry **p = &c->slots[cache_hash(&e->key) & (c->slot_count - 1)];
+    while (*p != e) p = &(*p)->chain;
+    *p = e->chain;
+    cache_unlink(c, e);
+    c->bytes -= cache_entry_bytes(e->count);
+    c->count--;
+    free(e);
+}
+
+// Drops every entry when the graph is no longer the version they were found on.
+static inline void cache_check(Cache *c, unsigned version) {
+    if (c->version == version) return;
+    while (c->oldest) cache_drop(c, c->oldest);
+    c->version = version;
+}
+
+static inline CacheEntry *cache_find(const Cache *c, const CacheKey *k) {
+    if (!c->slot_count) return NULL;
+    CacheEntry *e = c->slots[cache_hash(k) & (c->slot_count - 1)];
+    while (e && memcmp(&e->key, k, sizeof(*k)) != 0) e = e->chain;
+    return e;
+}
+
+// On a hit copies the entry's header to out and its nodes and edges to nodes and edges, and
+// returns 1; returns 0 otherwise. The caller counts the outcome with cache_count once it knows
+// whether the entry served the query.
+static inline int cache_get(Cache *c, unsigned version, const CacheKey *k, CacheEntry *out, int *nodes, int *edges) {
+    if (!c->budget) return 0;
+    pthread_mutex_lock(&c->lock);
+    cache_check(c, version);
+    CacheEntry *e = cache_find(c, k);
+    if (e) {
+        cache_unlink(c, e);
+        cache_push(c, e);
+        *out = *e;
+        memcpy(nodes, e->path, e->count * sizeof(int));
+        memcpy(edges, e->path + e->count, e->count * sizeof(int));
+    }
+    pthread_mutex_unlock(&c->lock);
+    return e != NULL;
+}
+
+// Counts a query answered from the cache (hit set) or by a search.
+static inline void cache_count(Cache *c, int hit) {
+    pthread_mutex_lock(&c->lock);
+    if (hit) c->hits++; else c->misses++;
+    pthread_mutex_unlock(&c->lock);
+}
+
+// Stores a route found on graph version; edges[i] is the edge into nodes[i], -1 at the first.
+static inline void cache_put(Cache *c, unsigned version, const CacheKey *k, const CacheTrip *trip,
+                             const int *nodes, const int *edges, int count) {
+    size_t bytes = cache_entry_bytes(count);
+    if (bytes > c->budget) return;
+    CacheEntry *e = (CacheEntry *)malloc(bytes);
+    e->key = *k; e->trip = *trip; e->count = count;
+    memcpy(e->path, nodes, count * sizeof(int));
+    memcpy(e->path + count, edges, count * sizeof(int));
+    pthread_mutex_lock(&c->lock);
+    cache_check(c, version);
+    CacheEntry *old = cache_find(c, k);
+    if (old) cache_drop(c, old);    // another thread found the same trip meanwhile
+    while (c->bytes + bytes > c->budget) cache_drop(c, c->oldest);
+    if (c->count + 1 > c->slot_count) {
+        // Keep the load at most 1: rehash into twice the slots.
+        int n = c->slot_count ? c->slot_count * 2 : CACHE_MIN_SLOTS;
+        CacheEntry **slots = (CacheEntry **)calloc(n, sizeof(CacheEntry *));
+        for (int i = 0; i < c->slot_count; i++)
+            for (CacheEntry *x = c->slots[i], *next; x; x = next) {
+                next = x->chain;
+                CacheEntry **p = &slots[cache_hash(&x->key) & (n - 1)];
+                x->chain = *p; *p = x;
+            }
+        free(c->slots);
+        c->slots = slots; c->slot_count = n;
+    }
+    CacheEntry **p = &c->slots[cache_hash(k) & (c->slot_count - 1)];
+    e->chain = *p; *p = e;
+    cache_push(c, e);
+    c->bytes += bytes;
+    c->count++;
+    pthread_mutex_unlock(&c->lock);
+}
+
+static inline void cache_free(Cache *c) {
+    if (c->slots) while (c->oldest) cache_drop(c, c->oldest);
+    free(c->slots);
+    c->slots = NULL; c->slot_count = 0;
+    pthread_mutex_destroy(&c->lock);
+}
+
+#endif
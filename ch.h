@@ -0,0 +1,418 @@
+#ifndef CH_H
+#define CH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "graph.h"
+#include "route.h"
+#include "snapshot.h"
+
+// Contraction Hierarchies for distance queries over a fixed set of modes (the road network).
+// ch_build contracts nodes one by one in order of edge difference, adding a shortcut u -> w
+// whenever the only shortest u -> w path ran through the contracted node; a node's rank is its
+// position in that order. A query then searches upwards from both ends over arcs towards
+// higher ranks and meets at the top, touching a few hundred nodes instead of the whole graph.
+// Every arc remembers the two arcs it replaces (or the graph edge it came from), so the
+// unpacked path is a plain node sequence over the original edges.
+// ch_save/ch_load keep the hierarchy next to the graph snapshot, with the same header checks.
+
+#define CH_MAGIC "RDCHIER"
+#define CH_VERSION 1
+#define CH_WITNESS_SETTLE 100   // settled-node budget of one witness search
+
+typedef struct {
+    int from, to;
+    double w;           // km
+    int child[2];       // arcs this shortcut replaces, -1 for an original edge
+    int edge;           // graph edge of an original arc, -1 for a shortcut
+} ChArc;
+
+typedef struct {
+    int node_count, arc_count;
+    unsigned mask;      // modes the hierarchy covers
+    int *rank;
+    ChArc *arcs;
+    int *up_off, *up_arc;       // arcs leaving each node towards higher rank
+    int *down_off, *down_arc;   // arcs entering each node from higher rank
+    void *map;
+    size_t map_size;
+} ContractionHierarchy;
+
+typedef struct {
+    char magic[8];
+    uint32_t version, source_count;
+    int32_t node_count, arc_count, graph_edges;
+    uint32_t mask;
+    uint64_t file_size, checksum;
+    SourceStamp sources[SNAPSHOT_MAX_SOURCES];
+    uint64_t off_rank, off_arcs, off_up_off, off_up_arc, off_down_off, off_down_arc;
+} ChHeader;
+
+// Contraction state: the remaining graph as per-node arc lists, scanned lazily past
+// contracted neighbours.
+typedef struct {
+    int *arc, n, cap;
+} ChList;
+
+typedef struct {
+    int n;
+    ChArc *arcs;
+    int arc_count, arc_cap;
+    ChList *out, *in;
+    unsigned char *contracted;
+    int *deleted_neighbours, *level;
+    // Witness search scratch
+    double *dist;
+    unsigned *stamp, gen;
+    IndexedHeap heap;
+} ChBuilder;
+
+static inline void ch_list_add(ChList *l, int a) {
+    if (l->n == l->cap) { l->cap = l->cap ? l->cap * 2 : 4; l->arc = (int *)realloc(l->arc, l->cap * sizeof(int)); }
+    l->arc[l->n++] = a;
+}
+
+// Drops arcs whose far end has been contracted.
+static inline void ch_list_prune(ChBuilder *b, ChList *l, int incoming) {
+    int k = 0;
+    for (int i = 0; i < l->n; i++) {
+        const ChArc *a = &b->arcs[l->arc[i]];
+        if (!b->contracted[incoming ? a->from : a->to]) l->arc[k++] = l->arc[i];
+    }
+    l->n = k;
+}
+
+static inline int ch_add_arc(ChBuilder *b, int from, int to, double w, int c0, int c1, int edge) {
+    if (b->arc_count == b->arc_cap) {
+        b->arc_cap = b->arc_cap ? b->arc_cap * 2 : 1024;
+        b->arcs = (ChArc *)realloc(b->arcs, b->arc_cap * sizeof(ChArc));
+    }
+    int a = b->arc_count++;
+    ChArc *x = &b->arcs[a];
+    x->from = from; x->to = to; x->w = w; x->child[0] = c0; x->child[1] = c1; x->edge = edge;
+    ch_list_add(&b->out[from], a); ch_list_add(&b->in[to], a);
+    return a;
+}
+
+// Dijkstra from u over uncontracted nodes, skipping v, until keys pass limit or the budget runs out.
+static inline void ch_witness(ChBuilder *b, int u, int v, double limit) {
+    if (++b->gen == 0) { memset(b->stamp, 0, b->n * sizeof(unsigned)); b->gen = 1; }
+    b->stamp[u] = b->gen; b->dist[u] = 0;
+    heap_push(&b->heap, u, 0);
+    int settled = 0;
+    while (!heap_empty(&b->heap) && settled < CH_WITNESS_SETTLE) {
+        if (heap_top_key(&b->heap) > limit) break;
+        int x = heap_pop(&b->heap);
+        settled++;
+        for (int i = 0; i < b->out[x].n; i++) {
+            const ChArc *a = &b->arcs[b->out[x].arc[i]];
+            int y = a->to;
+            if (y == v || b->contracted[y]) continue;
+            double d = b->dist[x] + a->w;
+            if (b->stamp[y] != b->gen || d < b->dist[y]) {
+                b->stamp[y] = b->gen; b->dist[y] = d;
+                heap_push(&b->heap, y, d);
+            }
+        }
+    }
+    heap_clear(&b->heap);
+}
+
+// Shortcuts needed to contract v; they are added when add is set. Also returns the number of
+// live arcs around v in *degree.
+static inline int ch_contract(ChBuilder *b, int v, int add, int *degree) {
+    int shortcuts = 0, deg = 0;
+    for (int i = 0; i < b->out[v].n; i++) if (!b->contracted[b->arcs[b->out[v].arc[i]].to]) deg++;
+    for (int i = 0; i < b->in[v].n; i++) {
+        int ain = b->in[v].arc[i];
+        int u = b->arcs[ain].from;
+        if (b->contracted[u]) continue;
+        deg++;
+        double limit = 0;
+        for (int j = 0; j < b->out[v].n; j++) {
+            const ChArc *o = &b->arcs[b->out[v].arc[j]];
+            if (!b->contracted[o->to] && o->to != u && b->arcs[ain].w + o->w > limit) limit = b->arcs[ain].w + o->w;
+        }
+        if (limit == 0) continue;
+        ch_witness(b, u, v, limit);
+        for (int j = 0; j < b->out[v].n; j++) {
+            int aout = b->out[v].arc[j];
+            int w = b->arcs[aout].to;
+            if (b->contracted[w] || w == u) continue;
+            double via = b->arcs[ain].w + b->arcs[aout].w;
+            if (b->stamp[w] == b->gen && b->dist[w] <= via) continue;
+            shortcuts++;
+            if (add) {
+                ch_add_arc(b, u, w, via, ain, aout, -1);
+                // Later witness searches from u should see the new arc as a witness
+                b->stamp[w] = b->gen; b->dist[w] = via;
+            }
+        }
+    }
+    if (degree) *degree = deg;
+    return shortcuts;
+}
+
+static inline double ch_priority(ChBuilder *b, int v) {
+    int deg;
+    int shortcuts = ch_contract(b, v, 0, &deg);
+    return (double)(2 * shortcuts - deg) + b->deleted_neighbours[v] + b->level[v];
+}
+
+// Arcs of the CSR pointed to by off/arc, sorted by which endpoint keyed them.
+static inline void ch_index(ContractionHierarchy *ch, int **off, int **arc, int upward) {
+    int n = ch->node_count;
+    *off = (int *)calloc(n + 1, sizeof(int));
+    int count = 0;
+    for (int a = 0; a < ch->arc_count; a++) {
+        const ChArc *x = &ch->arcs[a];
+        int up = ch->rank[x->from] < ch->rank[x->to];
+        if (up == upward) { (*off)[(upward ? x->from : x->to) + 1]++; count++; }
+    }
+    for (int v = 0; v < n; v++) (*off)[v + 1] += (*off)[v];
+    *arc = (int *)malloc((count ? count : 1) * sizeof(int));
+    int *fill = (int *)malloc((n + 1) * sizeof(int));
+    memcpy(fill, *off, (n + 1) * sizeof(int));
+    for (int a = 0; a < ch->arc_count; a++) {
+        const ChArc *x = &ch->arcs[a];
+        int up = ch->rank[x->from] < ch->rank[x->to];
+        if (up == upward) (*arc)[fill[upward ? x->from : x->to]++] = a;
+    }
+    free(fill);
+}
+
+// Contracts the subgraph of g made of edges whose mode is in mask.
+static inline void ch_build(ContractionHierarchy *ch, const Graph *g, unsigned mask) {
+    int n = g->node_count;
+    size_t cap = n > 0 ? n : 1;
+    ChBuilder b;
+    memset(&b, 0, sizeof(b));
+    b.n = n;
+    b.out = (ChList *)calloc(cap, sizeof(ChList));
+    b.in = (ChList *)calloc(cap, sizeof(ChList));
+    b.contracted = (unsigned char *)calloc(cap, 1);
+    b.deleted_neighbours = (int *)calloc(cap, sizeof(int));
+    b.level = (int *)calloc(cap, sizeof(int));
+    b.dist = (double *)malloc(cap * sizeof(double));
+    b.stamp = (unsigned *)calloc(cap, sizeof(unsigned));
+    heap_init(&b.heap, n);
+    for (int u = 0; u < n; u++)
+        for (int e = g->off[u]; e < g->off[u+1]; e++)
+            if (mask & (1u << g->mode[e])) ch_add_arc(&b, u, g->to[e], g->dist[e], -1, -1, e);
+
+    memset(ch, 0, sizeof(*ch));
+    ch->node_count = n; ch->mask = mask;
+    ch->rank = (int *)malloc(cap * sizeof(int));
+
+    // Neighbours of a contracted node are re-prioritised at once; lazy updates catch the rest:
+    // a popped node whose priority went up since it was queued goes back in.
+    IndexedHeap order;
+    heap_init(&order, n);
+    for (int v = 0; v < n; v++) heap_push(&order, v, ch_priority(&b, v));
+    for (int next_rank = 0; !heap_empty(&order); ) {
+        int v = heap_pop(&order);
+        double p = ch_priority(&b, v);
+        if (!heap_empty(&order) && p > heap_top_key(&order)) { heap_push(&order, v, p); continue; }
+        ch_contract(&b, v, 1, NULL);
+        b.contracted[v] = 1;
+        ch->rank[v] = next_rank++;
+        for (int i = 0; i < b.out[v].n + b.in[v].n; i++) {
+            const ChArc *a = &b.arcs[i < b.out[v].n ? b.out[v].arc[i] : b.in[v].arc[i - b.out[v].n]];
+            int w = a->from == v ? a->to : a->from;
+            if (b.contracted[w]) continue;
+            b.deleted_neighbours[w]++;
+            if (b.level[w] < b.level[v] + 1) b.level[w] = b.level[v] + 1;
+        }
+        for (int i = 0; i < b.out[v].n + b.in[v].n; i++) {
+            const ChArc *a = &b.arcs[i < b.out[v].n ? b.out[v].arc[i] : b.in[v].arc[i - b.out[v].n]];
+            int w = a->from == v ? a->to : a->from;
+            if (b.contracted[w]) continue;
+            ch_list_prune(&b, &b.out[w], 0); ch_list_prune(&b, &b.in[w], 1);
+            heap_update(&order, w, ch_priority(&b, w));
+        }
+    }
+    heap_free(&order);
+
+    ch->arcs = b.arcs; ch->arc_count = b.arc_count;
+    ch_index(ch, &ch->up_off, &ch->up_arc, 1);
+    ch_index(ch, &ch->down_off, &ch->down_arc, 0);
+    for (int v = 0; v < n; v++) { free(b.out[v].arc); free(b.in[v].arc); }
+    free(b.out); free(b.in); free(b.contracted); free(b.deleted_neighbours); free(b.level); free(b.dist); free(b.stamp);
+    heap_free(&b.heap);
+}
+
+static inline void ch_free(ContractionHierarchy *ch) {
+    if (ch->map) munmap(ch->map, ch->map_size);
+    else { free(ch->rank); free(ch->arcs); free(ch->up_off); free(ch->up_arc); free(ch->down_off); free(ch->down_arc); }
+    memset(ch, 0, sizeof(*ch));
+}
+
+// Writes ch, built over g, to path. Returns 1 on success.
+static inline int ch_save(const ContractionHierarchy *ch, const Graph *g, const char *path, const char **sources, int source_count) {
+    if (source_count > SNAPSHOT_MAX_SOURCES) return 0;
+    int n = ch->node_count, up = ch->up_off[n], down = ch->down_off[n];
+    ChHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CH_MAGIC, 8);
+    h.version = CH_VERSION; h.source_count = source_count;
+    h.node_count = n; h.arc_count = ch->arc_count; h.graph_edges = g->edge_count; h.mask = ch->mask;
+    for (int i = 0; i < source_count; i++) snapshot_stamp(&h.sources[i], sources[i]);
+
+    uint64_t at = snapshot_align(sizeof(h));
+    h.off_rank = at;     at = snapshot_align(at + (uint64_t)n * sizeof(int));
+    h.off_arcs = at;     at = snapshot_align(at + (uint64_t)ch->arc_count * sizeof(ChArc));
+    h.off_up_off = at;   at = snapshot_align(at + (uint64_t)(n + 1) * sizeof(int));
+    h.off_up_arc = at;   at = snapshot_align(at + (uint64_t)up * sizeof(int));
+    h.off_down_off = at; at = snapshot_align(at + (uint64_t)(n + 1) * sizeof(int));
+    h.off_down_arc = at; at = snapshot_align(at + (uint64_t)down * sizeof(int));
+    h.file_size = at;
+
+    unsigned char *buf = (unsigned char *)calloc(1, at);
+    if (!buf) return 0;
+    memcpy(buf + h.off_rank, ch->rank, (size_t)n * sizeof(int));
+    memcpy(buf + h.off_arcs, ch->arcs, (size_t)ch->arc_count * sizeof(ChArc));
+    memcpy(buf + h.off_up_off, ch->up_off, (size_t)(n + 1) * sizeof(int));
+    memcpy(buf + h.off_up_arc, ch->up_arc, (size_t)up * sizeof(int));
+    memcpy(buf + h.off_down_off, ch->down_off, (size_t)(n + 1) * sizeof(int));
+    memcpy(buf + h.off_down_arc, ch->down_arc, (size_t)down * sizeof(int));
+    uint64_t body = snapshot_align(sizeof(h));
+    h.checksum = snapshot_checksum(buf + body, at - body);
+    memcpy(buf, &h, sizeof(h));
+
+    FILE *fp = fopen(path, "wb");
+    int ok = fp && fwrite(buf, 1, at, fp) == at;
+    if (fp) ok = (fclose(fp) == 0) && ok;
+    free(buf);
+    if (!ok) remove(path);
+    return ok;
+}
+
+// Maps path into ch if it is a valid hierarchy over g for mask, compiled from the current
+// sources. Returns 1 on success; on failure ch is left untouched.
+static inline int ch_load(ContractionHierarchy *ch, const Graph *g, unsigned mask, const char *path, const char **sources, int source_count) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ChHeader)) { close(fd); return 0; }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return 0;
+
+    const ChHeader *h = (const ChHeader *)map;
+    int ok = memcmp(h->magic, CH_MAGIC, 8) == 0 && h->version == CH_VERSION
+          && h->file_size == (uint64_t)st.st_size && (int)h->source_count == source_count
+          && h->node_count == g->node_count && h->graph_edges == g->edge_count && h->mask == mask;
+    for (int i = 0; ok && i < source_count; i++) {
+        SourceStamp cur;
+        snapshot_stamp(&cur, sources[i]);
+        ok = strcmp(cur.path, h->sources[i].path) == 0 && cur.size == h->sources[i].size && cur.mtime == h->sources[i].mtime;
+    }
+    uint64_t body = snapshot_align(sizeof(ChHeader));
+    if (ok) ok = snapshot_checksum((const unsigned char *)map + body, h->file_size - body) == h->checksum;
+    if (!ok) { munmap(map, st.st_size); return 0; }
+
+    unsigned char *base = (unsigned char *)map;
+    memset(ch, 0, sizeof(*ch));
+    ch->node_count = h->node_count; ch->arc_count = h->arc_count; ch->mask = h->mask;
+    ch->rank = (int *)(base + h->off_rank);
+    ch->arcs = (ChArc *)(base + h->off_arcs);
+    ch->up_off = (int *)(base + h->off_up_off);
+    ch->up_arc = (int *)(base + h->off_up_arc);
+    ch->down_off = (int *)(base + h->off_down_off);
+    ch->down_arc = (int *)(base + h->off_down_arc);
+    ch->map = map; ch->map_size = st.st_size;
+    return 1;
+}
+
+// Appends arc a, expanded to original edges, to the prev chain.
+static inline void ch_unpack(const ContractionHierarchy *ch, Workspace *ws, int a) {
+    const ChArc *x = &ch->arcs[a];
+    if (x->child[0] < 0) { ws->prev[x->to] = x->from; ws->prev_edge[x->to] = x->edge; return; }
+    ch_unpack(ch, ws, x->child[0]);
+    ch_unpack(ch, ws, x->child[1]);
+}
+
+// Distance query over the hierarchy; honours entries/exits but not deadlines or schedules, and
+// only uses the modes in ch->mask. During the search prev/bnext hold the arc each node was
+// reached by; afterwards the Workspace looks as it does after a forward distance search.
+static inline int ch_search(const ContractionHierarchy *ch, const Graph *g, const Mode *modes, Workspace *ws, const Query *q) {
+    workspace_next(ws);
+    unsigned gen = ws->gen;
+    int seeds = q->entry_count ? q->entry_count : 1, sinks = q->exit_count ? q->exit_count : 1;
+    for (int i = 0; i < seeds; i++) {
+        int s = q->entry_count ? q->entries[i].node : q->src;
+        if (ws->seen[s] == gen) continue;
+        ws->seen[s] = gen; ws->prev[s] = -1; ws->prev_edge[s] = -1; ws->key[s] = 0;
+        ws->time_at[s] = q->start_time + (q->entry_count ? q->entries[i].walk_min : 0);
+        heap_push(&ws->heap, s, 0);
+    }
+    for (int i = 0; i < sinks; i++) {
+        int t = q->exit_count ? q->exits[i].node : q->dst;
+        if (ws->bseen[t] == gen) continue;
+        ws->bseen[t] = gen; ws->bnext[t] = -1; ws->bkey[t] = 0;
+        heap_push(&ws->bheap, t, 0);
+    }
+
+    double mu = INF; int meet = -1;
+    ws->target = -1; ws->settled = 0;
+    for (;;) {
+        double ft = heap_empty(&ws->heap) ? INF : heap_top_key(&ws->heap);
+        double bt = heap_empty(&ws->bheap) ? INF : heap_top_key(&ws->bheap);
+        if (ft >= mu && bt >= mu) break;
+        ws->settled++;
+        if (ft <= bt) {
+            int u = heap_pop(&ws->heap);
+            if (ws->bseen[u] == gen && ws->key[u] + ws->bkey[u] < mu) { mu = ws->key[u] + ws->bkey[u]; meet = u; }
+            STAT_ADD(STAT_RELAXED, ch->up_off[u+1] - ch->up_off[u]);
+            for (int i = ch->up_off[u]; i < ch->up_off[u+1]; i++) {
+                const ChArc *a = &ch->arcs[ch->up_arc[i]];
+                double k = ws->key[u] + a->w;
+                if (k < workspace_key(ws, a->to)) {
+                    ws->key[a->to] = k; ws->prev[a->to] = ch->up_arc[i]; ws->seen[a->to] = gen;
+                    heap_push(&ws->heap, a->to, k);
+                }
+            }
+        } else {
+            int u = heap_pop(&ws->bheap);
+            if (ws->seen[u] == gen && ws->key[u] + ws->bkey[u] < mu) { mu = ws->key[u] + ws->bkey[u]; meet = u; }
+            STAT_ADD(STAT_RELAXED, ch->down_off[u+1] - ch->down_off[u]);
+            for (int i = ch->down_off[u]; i < ch->down_off[u+1]; i++) {
+                const ChArc *a = &ch->arcs[ch->down_arc[i]];
+                double k = ws->bkey[u] + a->w;
+                if (ws->bseen[a->from] != gen || k < ws->bkey[a->from]) {
+                    ws->bkey[a->from] = k; ws->bnext[a->from] = ch->down_arc[i]; ws->bseen[a->from] = gen;
+                    heap_push(&ws->bheap, a->from, k);
+                }
+            }
+        }
+    }
+    heap_clear(&ws->heap);
+    heap_clear(&ws->bheap);
+    if (meet < 0) return 0;
+
+    // Expand the upward half back to its source, then the downward half on to the target.
+    // Unpacking an arc only writes prev of nodes after its tail, so the arc ids still needed
+    // further back are never overwritten.
+    for (int v = meet; ws->prev[v] != -1; ) {
+        int a = ws->prev[v];
+        ch_unpack(ch, ws, a);
+        v = ch->arcs[a].from;
+    }
+    int v = meet;
+    while (ws->bnext[v] != -1) {
+        int a = ws->bnext[v];
+        ch_unpack(ch, ws, a);
+        v = ch->arcs[a].to;
+    }
+    ws->target = v;
+    route_fill_path(g, modes, ws);
+    return 1;
+}
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Streaming reader for the map CSVs. The file is mapped read-only and lines and fields are
+// walked in place, so nothing is copied and a line may be any length. Numbers are parsed by
+// csv_number: a plain decimal with at most 19 significant digits whose mantissa fits in 53 bits
+// is one exact integer divided by an exact power of ten, which rounds exactly as strtod does;
+// anything else (exponents, very long mantissas) goes through strtod. csv_split cuts the file
+// into line-aligned ranges so several threads can parse one file.
+
+typedef struct {
+    const char *data;
+    size_t size;
+    void *map;
+} CsvFile;
+
+typedef struct {
+    const char *p, *end;
+    int line;               // 1-based number of the line last returned, within this range
+} CsvCursor;
+
+// Returns 0 if path cannot be opened or mapped. An empty file opens with size 0.
+static inline int csv_open(CsvFile *f, const char *path) {
+    memset(f, 0, sizeof(*f));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0) { close(fd); return 0; }
+    f->size = st.st_size;
+    if (f->size) {
+        f->map = mmap(NULL, f->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (f->map == MAP_FAILED) { close(fd); f->map = NULL; return 0; }
+        madvise(f->map, f->size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+    f->data = (const char *)f->map;
+    return 1;
+}
+
+static inline void csv_close(CsvFile *f) {
+    if (f->map) munmap(f->map, f->size);
+    memset(f, 0, sizeof(*f));
+}
+
+static inline CsvCursor csv_cursor(const CsvFile *f, size_t from, size_t to) {
+    CsvCursor c = { f->data + from, f->data + to, 0 };
+    return c;
+}
+
+// Next non-empty line as [*b, *e), without its line break. Returns 0 at the end of the range.
+static inline int csv_line(CsvCursor *c, const char **b, const char **e) {
+    while (c->p < c->end) {
+        const char *s = c->p, *nl = (const char *)memchr(s, '\n', c->end - s);
+        const char *t = nl ? nl : c->end;
+        c->p = nl ? nl + 1 : c->end;
+        c->line++;
+        if (t > s && t[-1] == '\r') t--;
+        if (t > s) { *b = s; *e = t; return 1; }
+    }
+    return 0;
+}
+
+// Field starting at *p on a line ending at e, as [*fb, *fe); *p moves past its comma, or to
+// NULL after the last field. Returns 0 once the line is used up.
+static inline int csv_field(const char **p, const char *e, const char **fb, const char **fe) {
+    if (!*p) return 0;
+    const char *comma = (const char *)memchr(*p, ',', e - *p);
+    *fb = *p; *fe = comma ? comma : e;
+    *p = comma ? comma + 1 : NULL;
+    return 1;
+}
+
+static const double csv_pow10[23] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Parses the whole of [b, e), blanks around it allowed, as a decimal number. Returns 0 if the
+// field is not a number.
+static inline int csv_number(const char *b, const char *e, double *out) {
+    while (b < e && (*b == ' ' || *b == '\t')) b++;
+    while (e > b && (e[-1] == ' ' || e[-1] == '\t')) e--;
+    const char *p = b;
+    int neg = 0, digits = 0, frac = 0, any = 0;
+    uint64_t mant = 0;
+    if (p < e && (*p == '-' || *p == '+')) neg = *p++ == '-';
+    for (; p < e && *p >= '0' && *p <= '9'; p++, any++) {
+        if (mant || *p != '0') digits++;
+        if (digits <= 19) mant = mant * 10 + (uint64_t)(*p - '0');
+    }
+    if (p < e && *p == '.')
+        for (p++; p < e && *p >= '0' && *p <= '9'; p++, any++) {
+            if (mant || *p != '0') digits++;
+            if (digits <= 19) { mant = mant * 10 + (uint64_t)(*p - '0'); frac++; }
+        }
+    if (!any) return 0;
+    if (p == e && digits <= 19 && mant <= (1ULL << 53) && frac <= 22) {
+        double v = (double)mant / csv_pow10[frac];
+        *out = neg ? -v : v;
+        return 1;
+    }
+    if (p < e && *p != 'e' && *p != 'E') return 0;
+    char buf[64], *stop;
+    if (e - b >= (long)sizeof(buf)) return 0;
+    memcpy(buf, b, e - b); buf[e - b] = '\0';
+    *out = strtod(buf, &stop);
+    return *stop == '\0';
+}
+
+// Parses the fields after the first one of [b, e) into *vals, grown as needed, stopping at the
+// first field that is not a number. Returns how many were parsed.
+static inline int csv_numbers(const char *b, const char *e, double **vals, int *cap) {
+    const char *p = b, *fb, *fe;
+    int n = 0;
+    if (!csv_field(&p, e, &fb, &fe)) return 0;
+    while (csv_field(&p, e, &fb, &fe)) {
+        if (n == *cap) {
+            *cap = *cap ? *cap * 2 : 256;
+            *vals = (double *)realloc(*vals, *cap * sizeof(double));
+        }
+        if (!csv_number(fb, fe, &(*vals)[n])) break;
+        n++;
+    }
+    return n;
+}
+
+// True when vals holds count / 2 valid lon,lat pairs.
+static inline int csv_valid_lonlat(const double *vals, int count) {
+    if (count % 2) return 0;
+    for (int i = 0; i < count; i += 2)
+        if (!(vals[i] >= -180 && vals[i] <= 180 && vals[i+1] >= -90 && vals[i+1] <= 90)) return 0;
+    return 1;
+}
+
+// Cuts f into parts line-aligned ranges [starts[i], starts[i+1]); starts has parts + 1 entries.
+// Ranges can be empty when lines are longer than a part.
+static inline void csv_split(const CsvFile *f, int parts, size_t *starts) {
+    starts[0] = 0;
+    for (int i = 1; i < parts; i++) {
+        size_t at = f->size / parts * i;
+        if (at < starts[i-1]) at = starts[i-1];
+        if (at == 0 || at >= f->size || f->data[at - 1] == '\n') { starts[i] = at < f->size ? at : f->size; continue; }
+        const char *nl = (const char *)memchr(f->data + at, '\n', f->size - at);
+        starts[i] = nl ? (size_t)(nl - f->data) + 1 : f->size;
+    }
+    starts[parts] = f->size;
+}
+
+#endif
@@ -0,0 +1,418 @@
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/mman.h>
+#include "node_grid.h"
+#include "csv.h"
+#include "stats.h"
+
+// Build-once graph in compressed sparse row form.
+// Loaders stage edges with graph_add_edge; graph_build then packs them by source node into
+// structure-of-arrays storage: off[u]..off[u+1] index the outgoing edges of u in to/dist/mode.
+// Per-edge attributes that only depend on the transport (fare, speed, schedule) live in the
+// mode table and are looked up through the small integer stored in mode[].
+// graph_simplify may run between loading and graph_build to drop the vertices that only shape
+// a line: their coordinates move into per-edge shape bytes, used for output only.
+
+#define MAX_MODES 16
+#define EARTH_PI 3.14159265358979323846
+
+typedef struct {
+    double lat, lon;
+} Coord;
+
+typedef struct {
+    char name[32];
+    double cost_rate;   // BDT per km
+    double speed;       // km/h
+    double interval;    // minutes between departures, 0 for on-demand (car)
+    int start_h, end_h; // service hours
+} Mode;
+
+typedef struct {
+    int node_count, edge_count, mode_count;
+    Coord *nodes;
+    int *off;               // node_count + 1 entries
+    int *to;
+    double *dist;           // km
+    unsigned char *mode;    // index into modes[]
+    Mode modes[MAX_MODES];
+
+    // Reverse CSR, built on demand by graph_build_reverse: rev_off[v]..rev_off[v+1] index the
+    // forward edges that end at v.
+    int *rev_off, *rev_edge, *rev_from;
+
+    // Shape points strictly between an edge's ends, NULL unless the graph was simplified:
+    // shape[shape_off[e]..shape_off[e+1]) holds zigzag varint deltas in microdegrees, lat then
+    // lon, the first point from the edge's tail node and each later one from the point before.
+    int *shape_off;
+    unsigned char *shape;
+    int shape_bytes;
+
+    // Live edits (update.h): per-edge speed factor, NULL until the first one; 0 closes the edge.
+    // version counts the update batches applied since loading.
+    float *factor;
+    unsigned version;
+
+    // Staging state, released by graph_build
+    int node_cap, edge_cap;
+    int *from;
+    NodeGrid grid;
+    unsigned char *pin;     // nodes graph_simplify must keep (line ends)
+    int pin_cap;
+
+    void *map;              // set when the arrays point into a mapped snapshot
+    size_t map_size;
+} Graph;
+
+// Great-circle distance in km
+static inline double haversine(double lat1, double lon1, double lat2, double lon2) {
+    double dLat = (lat2 - lat1) * EARTH_PI / 180.0;
+    double dLon = (lon2 - lon1) * EARTH_PI / 180.0;
+    double a = sin(dLat / 2) * sin(dLat / 2) + cos(lat1 * EARTH_PI / 180.0) * cos(lat2 * EARTH_PI / 180.0) * sin(dLon / 2) * sin(dLon / 2);
+    return 6371.0 * 2 * atan2(sqrt(a), sqrt(1 - a));
+}
+
+static inline int graph_add_mode(Graph *g, const char *name, double rate, double speed, double interval, int sh, int eh) {
+    Mode *m = &g->modes[g->mode_count];
+    size_t n = strnlen(name, sizeof(m->name) - 1);
+    memcpy(m->name, name, n); m->name[n] = '\0';
+    m->cost_rate = rate; m->speed = speed; m->interval = interval;
+    m->start_h = sh; m->end_h = eh;
+    return g->mode_count++;
+}
+
+// Returns the id of the mode called name, or -1.
+static inline int graph_mode_id(const Graph *g, const char *name) {
+    for (int i = 0; i < g->mode_count; i++) if (strcmp(g->modes[i].name, name) == 0) return i;
+    return -1;
+}
+
+// Returns the id of the node at (lat, lon), creating it if no node lies within GRID_EPS.
+static inline int graph_node_id(Graph *g, double lat, double lon) {
+    STAT_ADD(STAT_NODE_LOOKUPS, 1);
+    int id = grid_find(&g->grid, lat, lon);
+    if (id >= 0) return id;
+    if (g->node_count >= g->node_cap) {
+        g->node_cap = g->node_cap ? g->node_cap * 2 : 1024;
+        g->nodes = (Coord *)realloc(g->nodes, g->node_cap * sizeof(Coord));
+    }
+    grid_insert(&g->grid, lat, lon, g->node_count);
+    g->nodes[g->node_count].lat = lat; g->nodes[g->node_count].lon = lon;
+    return g->node_count++;
+}
+
+// Marks v as a node graph_simplify must keep.
+static inline void graph_pin(Graph *g, int v) {
+    if (v >= g->pin_cap) {
+        int cap = g->node_cap > v ? g->node_cap : v + 1;
+        g->pin = (unsigned char *)realloc(g->pin, cap);
+        memset(g->pin + g->pin_cap, 0, cap - g->pin_cap);
+        g->pin_cap = cap;
+    }
+    g->pin[v] = 1;
+}
+
+// Stages a directed edge. Zero-length self loops (repeated polyline points) are dropped.
+static inline void graph_add_edge(Graph *g, int u, int v, double d, int mode) {
+    if (u == v) return;
+    if (g->edge_count >= g->edge_cap) {
+        g->edge_cap = g->edge_cap ? g->edge_cap * 2 : 4096;
+        g->from = (int *)realloc(g->from, g->edge_cap * sizeof(int));
+        g->to = (int *)realloc(g->to, g->edge_cap * sizeof(int));
+        g->dist = (double *)realloc(g->dist, g->edge_cap * sizeof(double));
+        g->mode = (unsigned char *)realloc(g->mode, g->edge_cap * sizeof(unsigned char));
+    }
+    int e = g->edge_count++;
+    g->from[e] = u; g->to[e] = v; g->dist[e] = d; g->mode[e] = (unsigned char)mode;
+}
+
+// Packs staged edges into CSR order. Edges keep their insertion order within each node,
+// so searches visit neighbours in the same order as the old adjacency lists.
+static inline void graph_build(Graph *g) {
+    int n = g->node_count, m = g->edge_count;
+    g->off = (int *)calloc(n + 1, sizeof(int));
+    for (int e = 0; e < m; e++) g->off[g->from[e] + 1]++;
+    for (int u = 0; u < n; u++) g->off[u + 1] += g->off[u];
+
+    int *fill = (int *)malloc((n + 1) * sizeof(int));
+    memcpy(fill, g->off, (n + 1) * sizeof(int));
+    int *to = (int *)malloc((m ? m : 1) * sizeof(int));
+    double *dist = (double *)malloc((m ? m : 1) * sizeof(double));
+    unsigned char *mode = (unsigned char *)malloc(m ? m : 1);
+    int *order = g->shape_off ? (int *)malloc((m ? m : 1) * sizeof(int)) : NULL;
+    for (int e = 0; e < m; e++) {
+        int slot = fill[g->from[e]]++;
+        to[slot] = g->to[e]; dist[slot] = g->dist[e]; mode[slot] = g->mode[e];
+        if (order) order[slot] = e;
+    }
+    if (order) {
+        // Shapes follow their edges into CSR order.
+        int *shape_off = (int *)malloc((m + 1) * sizeof(int));
+        unsigned char *shape = (unsigned char *)malloc(g->shape_bytes ? g->shape_bytes : 1);
+        shape_off[0] = 0;
+        for (int i = 0; i < m; i++) {
+            int e = order[i], len = g->shape_off[e + 1] - g->shape_off[e];
+            memcpy(shape + shape_off[i], g->shape + g->shape_off[e], len);
+            shape_off[i + 1] = shape_off[i] + len;
+        }
+        free(g->shape_off); free(g->shape); free(order);
+        g->shape_off = shape_off; g->shape = shape;
+    }
+    free(fill); free(g->from); free(g->to); free(g->dist); free(g->mode); free(g->pin);
+    g->from = NULL; g->to = to; g->dist = dist; g->mode = mode;
+    g->pin = NULL; g->pin_cap = 0;
+    g->edge_cap = m;
+    grid_free(&g->grid);
+}
+
+static inline long graph_micro(double deg) { return lround(deg * 1e6); }
+
+static inline void graph_put_varint(unsigned char **buf, int *len, int *cap, long delta) {
+    unsigned long z = delta < 0 ? ((unsigned long)(-(delta + 1)) << 1) | 1 : (unsigned long)delta << 1;
+    if (*len + 10 > *cap) {
+        *cap = *cap ? *cap * 2 : 4096;
+        *buf = (unsigned char *)realloc(*buf, *cap);
+    }
+    do {
+        unsigned char b = z & 0x7f;
+        z >>= 7;
+        (*buf)[(*len)++] = z ? b | 0x80 : b;
+    } while (z);
+}
+
+static inline long graph_get_varint(const unsigned char **p) {
+    unsigned long z = 0; int shift = 0;
+    for (;;) {
+        unsigned char b = *(*p)++;
+        z |= (unsigned long)(b & 0x7f) << shift;
+        if (!(b & 0x80)) break;
+        shift += 7;
+    }
+    return z & 1 ? -(long)(z >> 1) - 1 : (long)(z >> 1);
+}
+
+// Reads the shape points of edge e in order; u must be e's tail.
+typedef struct {
+    const unsigned char *p, *end;
+    long lat, lon;          // microdegrees of the last point read
+} ShapeCursor;
+
+static inline void graph_shape_begin(const Graph *g, int u, int e, ShapeCursor *c) {
+    c->p = c->end = NULL;
+    if (g->shape_off) { c->p = g->shape + g->shape_off[e]; c->end = g->shape + g->shape_off[e + 1]; }
+    c->lat = graph_micro(g->nodes[u].lat); c->lon = graph_micro(g->nodes[u].lon);
+}
+
+// Returns 0 once every point has been read.
+static inline int graph_shape_next(ShapeCursor *c, Coord *out) {
+    if (c->p >= c->end) return 0;
+    c->lat += graph_get_varint(&c->p);
+    c->lon += graph_get_varint(&c->p);
+    out->lat = c->lat / 1e6; out->lon = c->lon / 1e6;
+    return 1;
+}
+
+// True when v only carries one line through: a single edge in and a single edge out (one way),
+// or a two-way street between two distinct neighbours, all of one mode.
+static inline int graph_pass_through(const Graph *g, const int *out_off, const int *out_e, const int *in_off, const int *in_e, int v) {
+    int outs = out_off[v+1] - out_off[v], ins = in_off[v+1] - in_off[v];
+    if (outs != ins || (outs != 1 && outs != 2)) return 0;
+    int mode = g->mode[out_e[out_off[v]]];
+    for (int i = 0; i < outs; i++) if (g->mode[out_e[out_off[v] + i]] != mode || g->mode[in_e[in_off[v] + i]] != mode) return 0;
+    if (outs == 1) return g->from[in_e[in_off[v]]] != g->to[out_e[out_off[v]]];
+    int a = g->to[out_e[out_off[v]]], b = g->to[out_e[out_off[v] + 1]];
+    int c = g->from[in_e[in_off[v]]], d = g->from[in_e[in_off[v] + 1]];
+    return a != b && ((a == c && b == d) || (a == d && b == c));
+}
+
+// Next edge along a line entering pass-through node v from prev.
+static inline int graph_pass_next(const Graph *g, const int *out_off, const int *out_e, int v, int prev) {
+    int e = out_e[out_off[v]];
+    return out_off[v+1] - out_off[v] == 2 && g->to[e] == prev ? out_e[out_off[v] + 1] : e;
+}
+
+// Replaces every chain of pass-through nodes (see graph_pass_through) between kept nodes by one
+// edge with the summed length, keeping the dropped coordinates as its shape. Pinned nodes and
+// every node where lines meet, end or change mode are kept, so searches see the same
+// distances and fares between them. Call after loading, before graph_build; node ids change.
+static inline void graph_simplify(Graph *g) {
+    int n = g->node_count, m = g->edge_count;
+    int *out_off = (int *)calloc(n + 1, sizeof(int)), *in_off = (int *)calloc(n + 1, sizeof(int));
+    int *out_e = (int *)malloc((m ? m : 1) * sizeof(int)), *in_e = (int *)malloc((m ? m : 1) * sizeof(int));
+    for (int e = 0; e < m; e++) { out_off[g->from[e] + 1]++; in_off[g->to[e] + 1]++; }
+    for (int v = 0; v < n; v++) { out_off[v + 1] += out_off[v]; in_off[v + 1] += in_off[v]; }
+    int *fo = (int *)malloc((n + 1) * sizeof(int)), *fi = (int *)malloc((n + 1) * sizeof(int));
+    memcpy(fo, out_off, (n + 1) * sizeof(int)); memcpy(fi, in_off, (n + 1) * sizeof(int));
+    for (int e = 0; e < m; e++) { out_e[fo[g->from[e]]++] = e; in_e[fi[g->to[e]]++] = e; }
+    free(fo); free(fi);
+
+    unsigned char *keep = (unsigned char *)malloc(n ? n : 1), *seen = (unsigned char *)calloc(n ? n : 1, 1);
+    for (int v = 0; v < n; v++)
+        keep[v] = (v < g->pin_cap && g->pin[v]) || !graph_pass_through(g, out_off, out_e, in_off, in_e, v);
+    // Mark what the kept nodes reach; a loop of pass-through nodes alone keeps one of its own.
+    for (int pass = 0; pass < 2; pass++)
+        for (int v = 0; v < n; v++) {
+            if (pass == 0 ? !keep[v] : keep[v] || seen[v]) continue;
+            keep[v] = 1;
+            for (int i = out_off[v]; i < out_off[v+1]; i++)
+                for (int prev = v, e = out_e[i]; !keep[g->to[e]]; ) {
+                    int w = g->to[e];
+                    seen[w] = 1;
+                    e = graph_pass_next(g, out_off, out_e, w, prev); prev = w;
+                }
+        }
+
+    int *id = (int *)malloc((n ? n : 1) * sizeof(int)), kept = 0;
+    for (int v = 0; v < n; v++) id[v] = keep[v] ? kept++ : -1;
+    int *from = (int *)malloc((m ? m : 1) * sizeof(int)), *to = (int *)malloc((m ? m : 1) * sizeof(int));
+    double *dist = (double *)malloc((m ? m : 1) * sizeof(double));
+    unsigned char *mode = (unsigned char *)malloc(m ? m : 1);
+    int *shape_off = (int *)malloc((m + 1) * sizeof(int)), count = 0, bytes = 0, cap = 0;
+    unsigned char *shape = NULL;
+    shape_off[0] = 0;
+    for (int e0 = 0; e0 < m; e0++) {
+        int u = g->from[e0];
+        if (!keep[u]) continue;
+        double d = g->dist[e0];
+        long lat = graph_micro(g->nodes[u].lat), lon = graph_micro(g->nodes[u].lon);
+        int prev = u, e = e0;
+        while (!keep[g->to[e]]) {
+            int w = g->to[e];
+            long la = graph_micro(g->nodes[w].lat), lo = graph_micro(g->nodes[w].lon);
+            graph_put_varint(&shape, &bytes, &cap, la - lat);
+            graph_put_varint(&shape, &bytes, &cap, lo - lon);
+            lat = la; lon = lo;
+            e = graph_pass_next(g, out_off, out_e, w, prev); prev = w;
+            d += g->dist[e];
+        }
+        from[count] = id[u]; to[count] = id[g->to[e]]; dist[count] = d; mode[count] = g->mode[e0];
+        shape_off[++count] = bytes;
+    }
+    for (int v = 0; v < n; v++) if (keep[v]) g->nodes[id[v]] = g->nodes[v];
+
+    free(g->from); free(g->to); free(g->dist); free(g->mode); free(g->shape_off); free(g->shape);
+    g->from = from; g->to = to; g->dist = dist; g->mode = mode;
+    g->shape_off = shape_off; g->shape = shape; g->shape_bytes = bytes;
+    g->node_count = kept; g->edge_count = count; g->edge_cap = m;
+    free(g->pin); g->pin = NULL; g->pin_cap = 0;
+    grid_free(&g->grid);    // ids changed, and no node is added after this
+    free(out_off); free(in_off); free(out_e); free(in_e); free(keep); free(seen); free(id);
+}
+
+// Speed multiplier of edge e: 1 unless an update slowed (0 < f < 1) or closed (0) it.
+static inline double graph_factor(const Graph *g, int e) {
+    return g->factor ? g->factor[e] : 1.0;
+}
+
+// Minutes to ride open edge e at m's speed times its factor.
+static inline double graph_ride_min(const Graph *g, const Mode *m, int e) {
+    return (g->dist[e] / (m->speed * graph_factor(g, e))) * 60.0;
+}
+
+// Returns the first edge u -> v, or -1.
+static inline int graph_find_edge(const Graph *g, int u, int v) {
+    for (int e = g->off[u]; e < g->off[u+1]; e++) if (g->to[e] == v) return e;
+    return -1;
+}
+
+// Builds the reverse adjacency used by backward searches. Safe on mapped snapshots, since the
+// reverse arrays are always heap allocated.
+static inline void graph_build_reverse(Graph *g) {
+    if (g->rev_off) return;
+    int n = g->node_count, m = g->edge_count;
+    g->rev_off = (int *)calloc(n + 1, sizeof(int));
+    g->rev_edge = (int *)malloc((m ? m : 1) * sizeof(int));
+    g->rev_from = (int *)malloc((m ? m : 1) * sizeof(int));
+    for (int e = 0; e < m; e++) g->rev_off[g->to[e] + 1]++;
+    for (int v = 0; v < n; v++) g->rev_off[v + 1] += g->rev_off[v];
+    int *fill = (int *)malloc((n + 1) * sizeof(int));
+    memcpy(fill, g->rev_off, (n + 1) * sizeof(int));
+    for (int u = 0; u < n; u++)
+        for (int e = g->off[u]; e < g->off[u+1]; e++) {
+            int slot = fill[g->to[e]]++;
+            g->rev_edge[slot] = e; g->rev_from[slot] = u;
+        }
+    free(fill);
+}
+
+// Bitmask per node of the modes on its incident edges; caller frees.
+static inline unsigned *graph_node_modes(const Graph *g) {
+    unsigned *mask = (unsigned *)calloc(g->node_count ? g->node_count : 1, sizeof(unsigned));
+    for (int u = 0; u < g->node_count; u++)
+        for (int e = g->off[u]; e < g->off[u+1]; e++) {
+            mask[u] |= 1u << g->mode[e];
+            mask[g->to[e]] |= 1u << g->mode[e];
+        }
+    return mask;
+}
+
+// Skips a line whose coordinates are not lon,lat pairs in range, with a warning.
+static inline int graph_check_line(const char *path, int line, const double *vals, int count) {
+    if (count >= 0 && csv_valid_lonlat(vals, count)) return 1;
+    fprintf(stderr, "Warning: %s:%d: bad coordinates, line skipped\n", path, line);
+    return 0;
+}
+
+// Roadmap-Dhaka.csv: "DhakaStreet,lon,lat,...,lon,lat,0,length". Roads are two-way.
+// Returns 0 if the file cannot be opened.
+static inline int graph_load_roads(Graph *g, const char *path, int mode) {
+    CsvFile f;
+    if (!csv_open(&f, path)) return 0;
+    CsvCursor cur = csv_cursor(&f, 0, f.size);
+    const char *b, *e;
+    double *c_vals = NULL; int cap = 0;
+    while (csv_line(&cur, &b, &e)) {
+        int c = csv_numbers(b, e, &c_vals, &cap) - 2;  // drop the trailing "0,length"
+        if (!graph_check_line(path, cur.line, c_vals, c)) continue;
+        for (int i = 0; i < c - 2; i += 2) {
+            int u = graph_node_id(g, c_vals[i+1], c_vals[i]); int v = graph_node_id(g, c_vals[i+3], c_vals[i+2]);
+            double d = haversine(g->nodes[u].lat, g->nodes[u].lon, g->nodes[v].lat, g->nodes[v].lon);
+            graph_add_edge(g, u, v, d, mode); graph_add_edge(g, v, u, d, mode);
+            if (i == 0) graph_pin(g, u);
+            if (i + 4 >= c) graph_pin(g, v);
+        }
+    }
+    free(c_vals);
+    csv_close(&f);
+    return 1;
+}
+
+// Routemap-*.csv: "Type,lon,lat,...,lon,lat,StartName,EndName". Routes run one way, in file order.
+// The coordinates end at the first field that is not a number. Returns 0 if the file cannot be
+// opened.
+static inline int graph_load_routes(Graph *g, const char *path, int mode) {
+    CsvFile f;
+    if (!csv_open(&f, path)) return 0;
+    CsvCursor cur = csv_cursor(&f, 0, f.size);
+    const char *b, *e;
+    double *c_vals = NULL; int cap = 0;
+    while (csv_line(&cur, &b, &e)) {
+        int c = csv_numbers(b, e, &c_vals, &cap);
+        if (!graph_check_line(path, cur.line, c_vals, c)) continue;
+        for (int j = 0; j < c - 2; j += 2) {
+            int u = graph_node_id(g, c_vals[j+1], c_vals[j]); int v = graph_node_id(g, c_vals[j+3], c_vals[j+2]);
+            graph_add_edge(g, u, v, haversine(g->nodes[u].lat, g->nodes[u].lon, g->nodes[v].lat, g->nodes[v].lon), mode);
+            if (j == 0) graph_pin(g, u);
+            if (j + 4 >= c) graph_pin(g, v);
+        }
+    }
+    free(c_vals);
+    csv_close(&f);
+    return 1;
+}
+
+static inline void graph_free(Graph *g) {
+    if (g->map) munmap(g->map, g->map_size);
+    else { free(g->nodes); free(g->off); free(g->to); free(g->dist); free(g->mode); free(g->shape_off); free(g->shape); }
+    free(g->from); free(g->pin); free(g->factor);
+    free(g->rev_off); free(g->rev_edge); free(g->rev_from);
+    grid_free(&g->grid);
+    memset(g, 0, sizeof(*g));
+}
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef ISOCHRONE_H
+#define ISOCHRONE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "graph.h"
+#include "route.h"
+#include "geo.h"
+
+// Reachable area from one bounded one-to-all search, rasterised onto a lat/lon grid of
+// ISO_CELL_KM cells. A cell's time is the earliest arrival at it: at a reached node inside it,
+// or on foot from any reached node (or the origin) up to ISO_WALK_KM away. Bands are written
+// as KML polygons, one rectangle per horizontal run of cells in the same band, so the rings
+// never overlap and need no hole handling. Walking distances to a row of cell centres come from
+// the batched kernel in geo.h.
+
+#define ISO_CELL_KM 0.1
+#define ISO_WALK_KM 0.5     // walk beyond the network no further than the snap distance
+#define ISO_KM_PER_DEG 111.195
+
+typedef struct {
+    int w, h;
+    double lat0, lon0, dlat, dlon;  // south-west corner and cell size in degrees
+    float *t;                       // minutes after the start, INF when out of reach
+    GeoPoints centers;              // cell centres, row-major
+    double *row;                    // distances to one row of centres
+} Isochrone;
+
+// Lowers every cell within walking reach of (lat, lon), reached t minutes after the start.
+static inline void isochrone_spread(Isochrone *iso, double lat, double lon, double t, double budget) {
+    double r = (budget - t) / 60.0 * WALK_SPEED;
+    if (r > ISO_WALK_KM) r = ISO_WALK_KM;
+    int cx = (int)((lon - iso->lon0) / iso->dlon), cy = (int)((lat - iso->lat0) / iso->dlat);
+    if (cx >= 0 && cx < iso->w && cy >= 0 && cy < iso->h && t < iso->t[cy * iso->w + cx]) iso->t[cy * iso->w + cx] = (float)t;
+    if (r <= 0) return;
+    int rx = (int)ceil(r / (iso->dlon * ISO_KM_PER_DEG * cos(lat * EARTH_PI / 180.0))), ry = (int)ceil(r / (iso->dlat * ISO_KM_PER_DEG));
+    int x0 = cx - rx < 0 ? 0 : cx - rx, x1 = cx + rx >= iso->w ? iso->w - 1 : cx + rx;
+    if (x0 > x1) return;
+    for (int y = cy - ry; y <= cy + ry; y++) {
+        if (y < 0 || y >= iso->h) continue;
+        geo_distances(&iso->centers, y * iso->w + x0, y * iso->w + x1 + 1, lat, lon, iso->row);
+        for (int x = x0; x <= x1; x++) {
+            double d = iso->row[x - x0];
+            if (d > r) continue;
+            double a = t + d / WALK_SPEED * 60.0;
+            if (a < iso->t[y * iso->w + x]) iso->t[y * iso->w + x] = (float)a;
+        }
+    }
+}
+
+// Rasterises the labels of the last search on ws, started at start_time from (lat, lon):
+// every node reached within budget minutes counts.
+static inline void isochrone_build(Isochrone *iso, const Graph *g, const Workspace *ws, double lat, double lon, double start_time, double budget) {
+    double s = lat, n = lat, w = lon, e = lon;
+    for (int v = 0; v < g->node_count; v++) {
+        if (ws->seen[v] != ws->gen || ws->time_at[v] - start_time > budget) continue;
+        const Coord *c = &g->nodes[v];
+        if (c->lat < s) s = c->lat;
+        if (c->lat > n) n = c->lat;
+        if (c->lon < w) w = c->lon;
+        if (c->lon > e) e = c->lon;
+    }
+    iso->dlat = ISO_CELL_KM / ISO_KM_PER_DEG;
+    iso->dlon = ISO_CELL_KM / (ISO_KM_PER_DEG * cos(lat * EARTH_PI / 180.0));
+    // Margin for the walk beyond the outermost nodes.
+    int pad = (int)ceil(ISO_WALK_KM / ISO_CELL_KM) + 2;
+    iso->lat0 = s - pad * iso->dlat; iso->lon0 = w - pad * iso->dlon;
+    iso->h = (int)((n - s) / iso->dlat) + 2 * pad + 1;
+    iso->w = (int)((e - w) / iso->dlon) + 2 * pad + 1;
+    size_t cells = (size_t)iso->w * iso->h;
+    iso->t = (float *)malloc(cells * sizeof(float));
+    for (size_t i = 0; i < cells; i++) iso->t[i] = (float)INF;
+    geo_points_init(&iso->centers, (int)cells);
+    for (int y = 0; y < iso->h; y++)
+        for (int x = 0; x < iso->w; x++) geo_points_set(&iso->centers, y * iso->w + x, iso->lat0 + (y + 0.5) * iso->dlat, iso->lon0 + (x + 0.5) * iso->dlon);
+    iso->row = (double *)malloc(iso->w * sizeof(double));
+    isochrone_spread(iso, lat, lon, 0, budget);
+    for (int v = 0; v < g->node_count; v++) {
+        if (ws->seen[v] != ws->gen) continue;
+        double t = ws->time_at[v] - start_time;
+        if (t <= budget) isochrone_spread(iso, g->nodes[v].lat, g->nodes[v].lon, t, budget);
+    }
+}
+
+static inline void isochrone_free(Isochrone *iso) {
+    free(iso->t); free(iso->row);
+    geo_points_free(&iso->centers);
+    iso->t = NULL; iso->row = NULL; iso->w = iso->h = 0;
+}
+
+// Band index of a cell: the first band whose limit it is within, or band_count.
+static inline int isochrone_band(const Isochrone *iso, int x, int y, const double *bands, int band_count) {
+    double t = iso->t[y * iso->w + x];
+    int b = 0;
+    while (b < band_count && t > bands[b]) b++;
+    return b;
+}
+
+// Writes one styled placemark per band (bands ascending, in minutes), green to red.
+static inline void isochrone_write_kml(const Isochrone *iso, FILE *kml, const double *bands, int band_count) {
+    fprintf(kml, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<kml xmlns=\"http://www.opengis.net/kml/2.2\">\n<Document>\n");
+    for (int b = 0; b < band_count; b++) {
+        int red = band_count > 1 ? 255 * b / (band_count - 1) : 0;
+        fprintf(kml, "<Style id=\"band%d\"><LineStyle><width>0</width></LineStyle><PolyStyle><color>80%02x%02x%02x</color></PolyStyle></Style>\n",
+                b, 0, 255 - red, red);
+    }
+    for (int b = 0; b < band_count; b++) {
+        fprintf(kml, "<Placemark><name>%g min</name><styleUrl>#band%d</styleUrl><MultiGeometry>\n", bands[b], b);
+        for (int y = 0; y < iso->h; y++)
+            for (int x = 0; x < iso->w; ) {
+                if (isochrone_band(iso, x, y, bands, band_count) != b) { x++; continue; }
+                int x0 = x;
+                while (x < iso->w && isochrone_band(iso, x, y, bands, band_count) == b) x++;
+                double s = iso->lat0 + y * iso->dlat, n = s + iso->dlat;
+                double w = iso->lon0 + x0 * iso->dlon, e = iso->lon0 + x * iso->dlon;
+                fprintf(kml, "<Polygon><outerBoundaryIs><LinearRing><coordinates>%f,%f,0 %f,%f,0 %f,%f,0 %f,%f,0 %f,%f,0</coordinates></LinearRing></outerBoundaryIs></Polygon>\n",
+                        w, s, e, s, e, n, w, n, w, s);
+            }
+        fprintf(kml, "</MultiGeometry></Placemark>\n");
+    }
+    fprintf(kml, "</Document></kml>");
+}
+
+#endif
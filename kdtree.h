@@ -0,0 +1,159 @@
+#ifndef KDTREE_H
+#define KDTREE_H
+
+#include <stdlib.h>
+#include <math.h>
+#include "graph.h"
+
+// Static k-d tree over the graph nodes for snapping query points.
+// Nodes are stored as unit vectors on the sphere, where straight-line (chord) distance grows
+// with great-circle distance, so plane distances bound haversine distances without any
+// projection error. The tree is implicit: the node of range [lo, hi) sits at its midpoint,
+// together with its split axis and the union of the mode masks below it, which lets
+// mode-filtered queries (nearest Metro node, nearest bus stop) skip whole subtrees.
+// Candidates are ranked by the same haversine the linear scan uses, ties by lower node id,
+// so kd_nearest returns exactly what route_nearest does.
+
+#define KD_EARTH_R 6371.0
+
+typedef struct {
+    double p[3];        // unit vector
+    double lat, lon;
+    int id;
+    unsigned modes;
+} KdPoint;
+
+typedef struct {
+    int count;
+    KdPoint *pts;           // in tree order
+    unsigned char *axis;
+    unsigned *sub_modes;    // modes present anywhere in the subtree rooted at each slot
+} KdTree;
+
+static inline void kd_unit(double lat, double lon, double *p) {
+    double la = lat * EARTH_PI / 180.0, lo = lon * EARTH_PI / 180.0;
+    p[0] = cos(la) * cos(lo); p[1] = cos(la) * sin(lo); p[2] = sin(la);
+}
+
+// Chord length between two points d_km apart along the surface.
+static inline double kd_chord(double d_km) {
+    return d_km >= EARTH_PI * KD_EARTH_R ? 2.0 : 2.0 * sin(d_km / (2.0 * KD_EARTH_R));
+}
+
+// Quickselect: places the k-th smallest point along axis at pts[k].
+static inline void kd_select(KdPoint *pts, int lo, int hi, int k, int axis) {
+    while (hi - lo > 1) {
+        double pivot = pts[lo + (hi - lo) / 2].p[axis];
+        int i = lo, j = hi - 1;
+        while (i <= j) {
+            while (pts[i].p[axis] < pivot) i++;
+            while (pts[j].p[axis] > pivot) j--;
+            if (i <= j) { KdPoint t = pts[i]; pts[i] = pts[j]; pts[j] = t; i++; j--; }
+        }
+        if (k <= j) hi = j + 1;
+        else if (k >= i) lo = i;
+        else return;
+    }
+}
+
+static inline unsigned kd_build_range(KdTree *t, int lo, int hi) {
+    if (lo >= hi) return 0;
+    double mn[3] = {2, 2, 2}, mx[3] = {-2, -2, -2};
+    for (int i = lo; i < hi; i++)
+        for (int a = 0; a < 3; a++) {
+            if (t->pts[i].p[a] < mn[a]) mn[a] = t->pts[i].p[a];
+            if (t->pts[i].p[a] > mx[a]) mx[a] = t->pts[i].p[a];
+        }
+    int axis = 0;
+    for (int a = 1; a < 3; a++) if (mx[a] - mn[a] > mx[axis] - mn[axis]) axis = a;
+    int mid = lo + (hi - lo) / 2;
+    kd_select(t->pts, lo, hi, mid, axis);
+    t->axis[mid] = (unsigned char)axis;
+    unsigned m = t->pts[mid].modes | kd_build_range(t, lo, mid) | kd_build_range(t, mid + 1, hi);
+    t->sub_modes[mid] = m;
+    return m;
+}
+
+// node_modes may be NULL, in which case every node matches every mask.
+static inline void kd_build(KdTree *t, const Graph *g, const unsigned *node_modes) {
+    int n = g->node_count;
+    size_t cap = n > 0 ? n : 1;
+    t->count = n;
+    t->pts = (KdPoint *)malloc(cap * sizeof(KdPoint));
+    t->axis = (unsigned char *)malloc(cap);
+    t->sub_modes = (unsigned *)malloc(cap * sizeof(unsigned));
+    for (int i = 0; i < n; i++) {
+        KdPoint *k = &t->pts[i];
+        kd_unit(g->nodes[i].lat, g->nodes[i].lon, k->p);
+        k->lat = g->nodes[i].lat; k->lon = g->nodes[i].lon;
+        k->id = i; k->modes = node_modes ? node_modes[i] : ~0u;
+    }
+    kd_build_range(t, 0, n);
+}
+
+static inline void kd_free(KdTree *t) {
+    free(t->pts); free(t->axis); free(t->sub_modes);
+    t->pts = NULL; t->axis = NULL; t->sub_modes = NULL; t->count = 0;
+}
+
+typedef struct {
+    double q[3], lat, lon;
+    unsigned mask;
+    int k, found;
+    double max_km;
+    int *ids;
+    double *dist;
+} KdSearch;
+
+static inline void kd_offer(KdSearch *s, const KdPoint *pt) {
+    double d = haversine(s->lat, s->lon, pt->lat, pt->lon);
+    if (d > s->max_km) return;
+    int i = s->found;
+    if (i == s->k) {
+        if (d > s->dist[i - 1] || (d == s->dist[i - 1] && pt->id > s->ids[i - 1])) return;
+        i--;
+    } else s->found++;
+    for (; i > 0 && (s->dist[i - 1] > d || (s->dist[i - 1] == d && s->ids[i - 1] > pt->id)); i--) {
+        s->dist[i] = s->dist[i - 1]; s->ids[i] = s->ids[i - 1];
+    }
+    s->dist[i] = d; s->ids[i] = pt->id;
+}
+
+static inline void kd_search_range(const KdTree *t, KdSearch *s, int lo, int hi) {
+    if (lo >= hi) return;
+    int mid = lo + (hi - lo) / 2;
+    if (!(t->sub_modes[mid] & s->mask)) return;
+    const KdPoint *pt = &t->pts[mid];
+    if (pt->modes & s->mask) kd_offer(s, pt);
+    double diff = s->q[t->axis[mid]] - pt->p[t->axis[mid]];
+    if (diff < 0) kd_search_range(t, s, lo, mid);
+    else kd_search_range(t, s, mid + 1, hi);
+    // The far side can only help if the splitting plane is closer than the current bound;
+    // the slack keeps rounding in the chord conversion from pruning an exact tie.
+    double bound = kd_chord(s->found == s->k ? s->dist[s->k - 1] : s->max_km) + 1e-12;
+    if (fabs(diff) <= bound) {
+        if (diff < 0) kd_search_range(t, s, mid + 1, hi);
+        else kd_search_range(t, s, lo, mid);
+    }
+}
+
+// Up to k nodes matching mask within max_km of (lat, lon), nearest first, written to ids and
+// dist_km (km). Pass INF for max_km to search without a radius. Returns the number found.
+static inline int kd_query(const KdTree *t, unsigned mask, double lat, double lon, int k, double max_km, int *ids, double *dist_km) {
+    KdSearch s;
+    kd_unit(lat, lon, s.q);
+    s.lat = lat; s.lon = lon; s.mask = mask; s.k = k; s.found = 0; s.max_km = max_km;
+    s.ids = ids; s.dist = dist_km;
+    if (k > 0) kd_search_range(t, &s, 0, t->count);
+    return s.found;
+}
+
+// Nearest node matching mask, or -1.
+static inline int kd_nearest(const KdTree *t, unsigned mask, double lat, double lon, double *dist_km) {
+    int id = -1; double d = 1e15;
+    kd_query(t, mask, lat, lon, 1, 1e15, &id, &d);
+    if (dist_km) *dist_km = d;
+    return id;
+}
+
+#endif
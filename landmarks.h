@@ -0,0 +1,246 @@
+#ifndef LANDMARKS_H
+#define LANDMARKS_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "graph.h"
+#include "pq.h"
+
+// Landmark lower bounds (ALT: A*, landmarks, triangle inequality) for the cost and time searches,
+// where fares and waits leave the straight-line bound far below the real value.
+// landmarks_build picks a few landmark nodes and stores, per landmark and objective, the least
+// objective from it to every node and from every node to it, over the modes in mask. For any
+// landmark L the triangle inequality then bounds the rest of a route from v to t from below:
+//   d(v, t) >= d(L, t) - d(L, v)   and   d(v, t) >= d(v, L) - d(t, L)
+// Edge weights are the least an edge can add to each objective: km, km times the fare, and
+// minutes at full speed, since waits, service hours, slowdowns and closures only add to them.
+// The bound therefore holds for any query whose modes are in mask with fares and speeds no
+// better than the table's, and stays valid under update.h's closures and slowdowns; a new
+// segment can shorten routes, so the tables must be rebuilt after one.
+// Landmarks are chosen by one of two strategies: farthest picks each one as far as possible from
+// those already chosen; avoid (Goldberg and Werneck) grows a shortest-path tree from a random
+// root and follows the subtree whose distances the current landmarks bound worst down to a leaf.
+// Tables are node-major so one bound reads two short runs. They stay double: the searches
+// settle a node for good once it leaves the queue only while the bound is consistent, and
+// float rounding breaks that on grids full of equal-length routes, re-settling whole subtrees.
+// For the same reason the bound gives up one fixed amount per objective, LANDMARK_SLACK of
+// its largest table entry, to absorb summation order, rather than a share of each term.
+
+#ifndef INF
+#define INF 1e15
+#endif
+
+#define MAX_LANDMARKS 64
+#define LANDMARK_OBJECTIVES 3   // indexed like Objective: distance, cost, time
+#define LANDMARK_SLACK 1e-9
+
+typedef enum { LANDMARKS_AVOID, LANDMARKS_FARTHEST } LandmarkStrategy;
+
+typedef struct {
+    int count, node_count;
+    unsigned mask;                          // modes the tables cover
+    int nodes[MAX_LANDMARKS];
+    double *from[LANDMARK_OBJECTIVES];      // [v * count + i]: least objective from landmark i to v, INF if unreachable
+    double *to[LANDMARK_OBJECTIVES];        // [v * count + i]: from v to landmark i; both NULL for objectives not built
+    double slack[LANDMARK_OBJECTIVES];
+} Landmarks;
+
+static const char *landmark_strategy_names[] = {"avoid", "farthest"};
+
+// Returns the strategy called name, or -1.
+static inline int landmark_strategy(const char *name) {
+    for (int i = 0; i < 2; i++) if (strcmp(name, landmark_strategy_names[i]) == 0) return i;
+    return -1;
+}
+
+// Least objective o gains over edge e of mode m.
+static inline double landmark_weight(const Graph *g, const Mode *m, int o, int e) {
+    return o == 0 ? g->dist[e] : o == 1 ? g->dist[e] * m->cost_rate : (g->dist[e] / m->speed) * 60.0;
+}
+
+// One-to-all Dijkstra on objective o from src over the modes in mask, along the edges or, with
+// backward set, against them (needs graph_build_reverse). out[v] is INF where src does not
+// reach. When order is set it receives the nodes in settling order and parent[v] the node v was
+// reached from (-1 at src). Returns the number of nodes settled.
+static inline int landmark_search(const Graph *g, const Mode *modes, unsigned mask, int o, int src, int backward,
+                                  IndexedHeap *h, double *out, int *parent, int *order) {
+    for (int v = 0; v < g->node_count; v++) out[v] = INF;
+    out[src] = 0;
+    if (parent) parent[src] = -1;
+    heap_push(h, src, 0);
+    int settled = 0;
+    while (!heap_empty(h)) {
+        int u = heap_pop(h);
+        if (order) order[settled] = u;
+        settled++;
+        int first = backward ? g->rev_off[u] : g->off[u], last = backward ? g->rev_off[u+1] : g->off[u+1];
+        for (int k = first; k < last; k++) {
+            int e = backward ? g->rev_edge[k] : k, v = backward ? g->rev_from[k] : g->to[k];
+            if (!(mask & (1u << g->mode[e]))) continue;
+            double d = out[u] + landmark_weight(g, &modes[g->mode[e]], o, e);
+            if (d < out[v]) {
+                out[v] = d;
+                if (parent) parent[v] = u;
+                heap_push(h, v, d);
+            }
+        }
+    }
+    return settled;
+}
+
+// Next landmark by farthest selection: the node whose nearest landmark (by km, from the
+// landmark) is farthest, preferring nodes no landmark reaches. near holds that distance per node
+// and is updated for the new landmark's tree by the caller.
+static inline int landmarks_pick_farthest(const Graph *g, const double *near, unsigned *node_modes, unsigned mask) {
+    int best = -1;
+    for (int v = 0; v < g->node_count; v++) {
+        if (!(node_modes[v] & mask)) continue;
+        if (best < 0 || near[v] > near[best]) best = v;
+    }
+    return best;
+}
+
+// Next landmark by avoid selection from root. dist and parent are root's km tree and order its
+// settling order (count nodes); lb is the current landmarks' km bound from root to each node.
+// Each node weighs dist - lb, a subtree weighs the sum of its nodes unless it already holds a
+// landmark, and the descent takes the heaviest child until it reaches a leaf.
+static inline int landmarks_pick_avoid(const Landmarks *lm, const double *dist, const double *lb, const int *parent,
+                                       const int *order, int count, double *size, int *child, unsigned char *has) {
+    for (int k = 0; k < count; k++) { int v = order[k]; size[v] = dist[v] - lb[v]; child[v] = -1; has[v] = 0; }
+    for (int i = 0; i < lm->count; i++) has[lm->nodes[i]] = 1;
+    for (int k = count - 1; k > 0; k--) {
+        int v = order[k], p = parent[v];
+        if (has[v]) { size[v] = 0; has[p] = 1; }
+        size[p] += size[v];
+        if (child[p] < 0 || size[v] > size[child[p]]) child[p] = v;
+    }
+    int v = order[0];
+    while (child[v] >= 0 && size[child[v]] > 0) v = child[v];
+    return has[v] ? -1 : v;
+}
+
+// km bound from root to every reached node given the landmarks chosen so far, from the km
+// tables fwd and bwd (stride landmarks per node, doubles).
+static inline void landmarks_km_bound(const Landmarks *lm, const double *fwd, const double *bwd, int stride, int root,
+                                      const int *order, int count, double *lb) {
+    const double *fr = fwd + (size_t)root * stride, *br = bwd + (size_t)root * stride;
+    for (int k = 0; k < count; k++) {
+        int v = order[k];
+        const double *fv = fwd + (size_t)v * stride, *bv = bwd + (size_t)v * stride;
+        double best = 0;
+        for (int i = 0; i < lm->count; i++) {
+            if (fv[i] < INF && fr[i] < INF && fv[i] - fr[i] > best) best = fv[i] - fr[i];
+            if (br[i] < INF && bv[i] < INF && br[i] - bv[i] > best) best = br[i] - bv[i];
+        }
+        lb[v] = best;
+    }
+}
+
+// Chooses count landmarks (at most MAX_LANDMARKS) among the nodes with a mode in mask and fills
+// the tables of every objective o with bit o set in objectives, for modes (the mode table of the
+// queries, or one with each mode's lowest fare and highest speed when several share the tables).
+// Builds the reverse adjacency if g has none.
+static inline void landmarks_build(Landmarks *lm, Graph *g, const Mode *modes, unsigned mask, int count,
+                                   LandmarkStrategy strategy, unsigned objectives) {
+    int n = g->node_count;
+    memset(lm, 0, sizeof(*lm));
+    lm->node_count = n; lm->mask = mask;
+    if (count > MAX_LANDMARKS) count = MAX_LANDMARKS;
+    if (n <= 0 || count <= 0) return;
+    graph_build_reverse(g);
+    unsigned *node_modes = graph_node_modes(g);
+    IndexedHeap h;
+    heap_init(&h, n);
+    double *dist = (double *)malloc(n * sizeof(double)), *near = (double *)malloc(n * sizeof(double));
+    double *lb = (double *)malloc(n * sizeof(double)), *size = (double *)malloc(n * sizeof(double));
+    double *fwd = (double *)malloc((size_t)n * count * sizeof(double)), *bwd = (double *)malloc((size_t)n * count * sizeof(double));
+    int *parent = (int *)malloc(n * sizeof(int)), *order = (int *)malloc(n * sizeof(int)), *child = (int *)malloc(n * sizeof(int));
+    unsigned char *has = (unsigned char *)malloc(n);
+    for (int v = 0; v < n; v++) near[v] = INF;
+    if (strategy == LANDMARKS_FARTHEST) {
+        // The first landmark is the node farthest from the first usable one; nodes out of its reach
+        // are never picked, so farthest suits one connected network and avoid a fragmented one.
+        int v0 = 0;
+        while (v0 < n && !(node_modes[v0] & mask)) v0++;
+        if (v0 < n) {
+            landmark_search(g, modes, mask, 0, v0, 0, &h, near, NULL, NULL);
+            for (int v = 0; v < n; v++) if (near[v] >= INF) near[v] = -1;
+        }
+    }
+
+    unsigned seed = 23;
+    for (int tries = 0; lm->count < count && tries < 4 * count; tries++) {
+        int pick;
+        if (strategy == LANDMARKS_FARTHEST) pick = landmarks_pick_farthest(g, near, node_modes, mask);
+        else {
+            seed = seed * 1103515245u + 12345u;
+            int root = (int)((seed >> 8) % (unsigned)n);
+            if (!(node_modes[root] & mask)) continue;
+            int reached = landmark_search(g, modes, mask, 0, root, 0, &h, dist, parent, order);
+            landmarks_km_bound(lm, fwd, bwd, count, root, order, reached, lb);
+            pick = landmarks_pick_avoid(lm, dist, lb, parent, order, reached, size, child, has);
+        }
+        if (pick < 0) { if (strategy == LANDMARKS_FARTHEST) break; continue; }
+        int i = lm->count++;
+        lm->nodes[i] = pick;
+        landmark_search(g, modes, mask, 0, pick, 0, &h, dist, NULL, NULL);
+        for (int v = 0; v < n; v++) { fwd[(size_t)v * count + i] = dist[v]; if (dist[v] < near[v]) near[v] = dist[v]; }
+        near[pick] = -1;
+        landmark_search(g, modes, mask, 0, pick, 1, &h, dist, NULL, NULL);
+        for (int v = 0; v < n; v++) bwd[(size_t)v * count + i] = dist[v];
+    }
+
+    int k = lm->count;
+    for (int o = 0; o < LANDMARK_OBJECTIVES; o++) {
+        if (!(objectives & (1u << o)) || !k) continue;
+        lm->from[o] = (double *)malloc((size_t)n * k * sizeof(double));
+        lm->to[o] = (double *)malloc((size_t)n * k * sizeof(double));
+        double largest = 0;
+        for (int i = 0; i < k; i++)
+            for (int backward = 0; backward < 2; backward++) {
+                double *t = backward ? lm->to[o] : lm->from[o];
+                if (o == 0) {
+                    // The km tables were filled while choosing.
+                    const double *km = backward ? bwd : fwd;
+                    for (int v = 0; v < n; v++) dist[v] = km[(size_t)v * count + i];
+                } else landmark_search(g, modes, mask, o, lm->nodes[i], backward, &h, dist, NULL, NULL);
+                for (int v = 0; v < n; v++) {
+                    t[(size_t)v * k + i] = dist[v];
+                    if (dist[v] < INF && dist[v] > largest) largest = dist[v];
+                }
+            }
+        lm->slack[o] = LANDMARK_SLACK * largest;
+    }
+    heap_free(&h);
+    free(dist); free(near); free(lb); free(size); free(fwd); free(bwd);
+    free(parent); free(order); free(child); free(has); free(node_modes);
+}
+
+static inline void landmarks_free(Landmarks *lm) {
+    for (int o = 0; o < LANDMARK_OBJECTIVES; o++) { free(lm->from[o]); free(lm->to[o]); }
+    memset(lm, 0, sizeof(*lm));
+}
+
+static inline size_t landmarks_bytes(const Landmarks *lm) {
+    size_t bytes = 0;
+    for (int o = 0; o < LANDMARK_OBJECTIVES; o++) if (lm->from[o]) bytes += 2 * (size_t)lm->node_count * lm->count * sizeof(double);
+    return bytes;
+}
+
+// Lower bound on objective o from v to t; 0 when there are no tables for o or no landmark
+// reaches both.
+static inline double landmarks_bound(const Landmarks *lm, int o, int v, int t) {
+    if (!lm || !lm->from[o]) return 0;
+    int k = lm->count;
+    const double *fv = lm->from[o] + (size_t)v * k, *ft = lm->from[o] + (size_t)t * k;
+    const double *tv = lm->to[o] + (size_t)v * k, *tt = lm->to[o] + (size_t)t * k;
+    double best = 0;
+    for (int i = 0; i < k; i++) {
+        if (ft[i] < INF && fv[i] < INF && ft[i] - fv[i] > best) best = ft[i] - fv[i];
+        if (tv[i] < INF && tt[i] < INF && tv[i] - tt[i] > best) best = tv[i] - tt[i];
+    }
+    return best > lm->slack[o] ? best - lm->slack[o] : 0;
+}
+
+#endif
@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "service.h"
+
+// Travel matrix: minutes, fare and distance from every origin to every destination under
+// one problem's modes and objective.
+//   matrix [--threads N] [--candidates K] [--start HH:MM] [--simplify] [--binary] [--out FILE] PROBLEM ORIGINS DESTINATIONS
+// ORIGINS and DESTINATIONS hold one "lat lon" (or "lat,lon") point per line; blank lines and
+// lines starting with '#' are skipped. Each origin is one one-to-all search (raptor_search for
+// the fastest-route problem, the Pareto search for a cost problem with scheduled modes, so a
+// wait is only paid when boarding, Dijkstra otherwise), after which every destination's cell is
+// read straight from the labels, so a row costs a single search however many destinations
+// there are. Threads claim origins one at a time, each with its own Session.
+// CSV output has one line per cell: origin,destination,minutes,cost_bdt,distance_km, with the
+// last three empty when the destination cannot be reached. --binary writes the magic "DMX1",
+// int32 rows and cols, then rows*cols float32 minutes, the costs and the distances, row-major,
+// with NAN for unreachable cells. Problem 6 is not supported: its deadline makes the best
+// route depend on the destination, which a one-to-all search cannot honour.
+
+typedef struct {
+    double lat, lon;
+    Access access[MAX_CANDIDATES];
+    int count;
+} Point;
+
+Service service;
+int problem;
+double start_time;
+Point *origins, *dests;
+int origin_count, dest_count;
+float *minutes, *cost, *dist;
+_Atomic int next_row;
+
+int read_points(const char *path, Point **out, int *count) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return 0;
+    char line[256];
+    int cap = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        char *s = line + strspn(line, " \t\r\n");
+        if (*s == '\0' || *s == '#') continue;
+        for (char *c = s; *c; c++) if (*c == ',') *c = ' ';
+        Point p;
+        if (sscanf(s, "%lf %lf", &p.lat, &p.lon) != 2) { fprintf(stderr, "Error: bad point in %s: %s", path, line); fclose(fp); return 0; }
+        if (*count == cap) {
+            cap = cap ? cap * 2 : 256;
+            *out = (Point *)realloc(*out, cap * sizeof(Point));
+        }
+        (*out)[(*count)++] = p;
+    }
+    fclose(fp);
+    return 1;
+}
+
+void solve_row(Session *ss, int i) {
+    const Graph *g = &service.graph;
+    const ProblemSpec *spec = &problems[problem - 1];
+    const Mode *modes = service.profiles[problem - 1];
+    Workspace *ws = &ss->ws;
+    if (!origins[i].count) {
+        // Nothing to start from: the whole row is unreachable.
+        for (size_t cell = (size_t)i * dest_count; cell < (size_t)(i + 1) * dest_count; cell++) minutes[cell] = cost[cell] = dist[cell] = NAN;
+        return;
+    }
+    Query q = { origins[i].access[0].node, -1, start_time, INF, spec->objective, service.masks[problem - 1],
+                origins[i].access, NULL, origins[i].count, 0, ALG_DIJKSTRA };
+    int pareto = spec->objective != OBJ_TIME && problem_has_schedule(spec);
+    if (spec->objective == OBJ_TIME) raptor_search(g, modes, &service.timetable, ws, &ss->rw, &q);
+    else if (pareto) pareto_search(g, modes, &service.timetable, ws, &ss->pw, &q);
+    else route_search(g, modes, ws, &q);
+
+    for (int j = 0; j < dest_count; j++) {
+        size_t cell = (size_t)i * dest_count + j;
+        minutes[cell] = cost[cell] = dist[cell] = NAN;
+        int end = -1; double best = INF, walk = 0, t = 0, c = 0, d = 0;
+        for (int k = 0; k < dests[j].count; k++) {
+            const Access *a = &dests[j].access[k];
+            int l = pareto ? pareto_best(&ss->pw, a->node, spec->objective) : -1;
+            double key = !pareto ? workspace_key(ws, a->node) : l < 0 ? INF
+                       : objective_total(spec->objective, ss->pw.labels[l].time, ss->pw.labels[l].cost, ss->pw.labels[l].dist);
+            double total = key + objective_exit(spec->objective, a->walk_min);
+            if (total >= best) continue;
+            best = total; end = a->node; walk = a->walk_min;
+            if (pareto) { t = ss->pw.labels[l].time; c = ss->pw.labels[l].cost; d = ss->pw.labels[l].dist; }
+        }
+        if (end < 0) continue;
+        if (!pareto) { t = ws->time_at[end]; c = ws->cost_at[end]; d = ws->dist_at[end]; }
+        if (spec->objective == OBJ_TIME) raptor_totals(g, modes, &service.timetable, ws, &ss->rw, end, &c, &d);
+        minutes[cell] = (float)(t + walk - start_time);
+        cost[cell] = (float)c; dist[cell] = (float)d;
+    }
+}
+
+void *worker_main(void *arg) {
+    Session *ss = (Session *)arg;
+    for (int i; (i = atomic_fetch_add(&next_row, 1)) < origin_count; ) solve_row(ss, i);
+    return NULL;
+}
+
+void write_csv(FILE *out) {
+    fprintf(out, "origin,destination,minutes,cost_bdt,distance_km\n");
+    for (int i = 0; i < origin_count; i++)
+        for (int j = 0; j < dest_count; j++) {
+            size_t cell = (size_t)i * dest_count + j;
+            if (isnan(minutes[cell])) fprintf(out, "%d,%d,,,\n", i, j);
+            else fprintf(out, "%d,%d,%.2f,%.2f,%.3f\n", i, j, minutes[cell], cost[cell], dist[cell]);
+        }
+}
+
+void write_binary(FILE *out) {
+    int32_t dims[2] = { origin_count, dest_count };
+    size_t cells = (size_t)origin_count * dest_count;
+    fwrite("DMX1", 1, 4, out);
+    fwrite(dims, sizeof(int32_t), 2, out);
+    fwrite(minutes, sizeof(float), cells, out);
+    fwrite(cost, sizeof(float), cells, out);
+    fwrite(dist, sizeof(float), cells, out);
+}
+
+double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv) {
+    const char *out_path = NULL, *paths[2] = { NULL, NULL };
+    int thread_count = (int)sysconf(_SC_NPROCESSORS_ONLN), binary = 0, simplify = 0, sh = -1, sm = 0, args = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) thread_count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--candidates") == 0 && i + 1 < argc) service.candidates = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--start") == 0 && i + 1 < argc && sscanf(argv[i + 1], "%d:%d", &sh, &sm) == 2) i++;
+        else if (strcmp(argv[i], "--simplify") == 0) simplify = 1;
+        else if (strcmp(argv[i], "--binary") == 0) binary = 1;
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) out_path = argv[++i];
+        else if (args == 0 && argv[i][0] != '-') { problem = atoi(argv[i]); args++; }
+        else if (args < 3 && argv[i][0] != '-') paths[args++ - 1] = argv[i];
+        else { args = 0; break; }
+    }
+    if (args < 3) { fprintf(stderr, "Usage: %s [--threads N] [--candidates K] [--start HH:MM] [--simplify] [--binary] [--out FILE] PROBLEM ORIGINS DESTINATIONS\n", argv[0]); return 1; }
+    if (problem < 1 || problem > 5) { fprintf(stderr, "Error: matrix supports problems 1-5\n"); return 1; }
+    const ProblemSpec *spec = &problems[problem - 1];
+    if (spec->start_time < 0 && sh < 0) { fprintf(stderr, "Error: problem %d needs --start HH:MM\n", problem); return 1; }
+    start_time = sh >= 0 ? sh * 60.0 + sm : spec->start_time;
+    if (thread_count < 1) thread_count = 1;
+    if (!read_points(paths[0], &origins, &origin_count) || !read_points(paths[1], &dests, &dest_count)) { fprintf(stderr, "Error: cannot read points\n"); return 1; }
+    FILE *out = out_path ? fopen(out_path, binary ? "wb" : "w") : stdout;
+    if (!out) { fprintf(stderr, "Error: cannot write %s\n", out_path); return 1; }
+
+    service_load(&service.graph, simplify);
+    service_init(&service);
+    unsigned mask = service.masks[problem - 1];
+    for (int i = 0; i < origin_count; i++) origins[i].count = service_snap(&service, mask, origins[i].lat, origins[i].lon, origins[i].access);
+    for (int j = 0; j < dest_count; j++) dests[j].count = service_snap(&service, mask, dests[j].lat, dests[j].lon, dests[j].access);
+    if (origin_count && !origins[0].count) { fprintf(stderr, "Error: graph is empty\n"); return 1; }
+    for (int i = 0; i < origin_count; i++) if (!origins[i].count) fprintf(stderr, "Warning: origin %d snaps to no usable node; its row is empty\n", i);
+    size_t cells = (size_t)origin_count * dest_count;
+    minutes = (float *)malloc((cells ? cells : 1) * sizeof(float));
+    cost = (float *)malloc((cells ? cells : 1) * sizeof(float));
+    dist = (float *)malloc((cells ? cells : 1) * sizeof(float));
+    Session *sessions = (Session *)calloc(thread_count, sizeof(Session));
+    pthread_t *threads = (pthread_t *)calloc(thread_count, sizeof(pthread_t));
+    for (int t = 0; t < thread_count; t++) session_init(&sessions[t], &service);
+
+    double t0 = now_sec();
+    for (int t = 0; t < thread_count; t++) pthread_create(&threads[t], NULL, worker_main, &sessions[t]);
+    for (int t = 0; t < thread_count; t++) pthread_join(threads[t], NULL);
+    double elapsed = now_sec() - t0;
+
+    if (binary) write_binary(out);
+    else write_csv(out);
+    if (out != stdout) fclose(out);
+    fprintf(stderr, "%d x %d matrix on %d threads in %.3f s: %.0f cells/s, %.1f ms per origin\n",
+            origin_count, dest_count, thread_count, elapsed, elapsed > 0 ? cells / elapsed : 0.0,
+            origin_count ? elapsed * 1000.0 * thread_count / origin_count : 0.0);
+
+    for (int t = 0; t < thread_count; t++) session_free(&sessions[t]);
+    free(sessions); free(threads); free(minutes); free(cost); free(dist); free(origins); free(dests);
+    service_free(&service);
+    return 0;
+}
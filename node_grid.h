@@ -0,0 +1,86 @@
+#ifndef NODE_GRID_H
+#define NODE_GRID_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+// Spatial hash used by get_node_id to deduplicate coordinates in O(1).
+// Coordinates are quantized to cells the size of the match tolerance, so two points within
+// tolerance always sit in the same or an adjacent cell; lookups probe the 3x3 neighbourhood
+// and keep the exact per-axis comparison, returning the lowest matching id like the old scan.
+// A zeroed NodeGrid is empty and ready to use.
+
+#define GRID_EPS 1e-7
+
+typedef struct {
+    int64_t cy, cx;
+    double lat, lon;
+    int id;         // -1 marks an empty slot
+} GridEntry;
+
+typedef struct {
+    GridEntry *slot;
+    int cap, count;  // cap is a power of two
+} NodeGrid;
+
+static inline uint64_t grid_hash(int64_t cy, int64_t cx) {
+    uint64_t h = (uint64_t)cy * 0x9E3779B97F4A7C15ULL ^ (uint64_t)cx * 0xC2B2AE3D27D4EB4FULL;
+    return h ^ (h >> 29);
+}
+
+static inline int64_t grid_cell(double v) { return (int64_t)floor(v / GRID_EPS); }
+
+static inline void grid_free(NodeGrid *g) {
+    free(g->slot);
+    g->slot = NULL; g->cap = g->count = 0;
+}
+
+static inline void grid_place(NodeGrid *g, const GridEntry *e) {
+    uint64_t i = grid_hash(e->cy, e->cx) & (g->cap - 1);
+    while (g->slot[i].id != -1) i = (i + 1) & (g->cap - 1);
+    g->slot[i] = *e;
+}
+
+static inline void grid_resize(NodeGrid *g, int cap) {
+    GridEntry *old = g->slot; int old_cap = g->cap;
+    g->slot = (GridEntry *)malloc(cap * sizeof(GridEntry));
+    g->cap = cap;
+    for (int i = 0; i < cap; i++) g->slot[i].id = -1;
+    for (int i = 0; i < old_cap; i++) if (old[i].id != -1) grid_place(g, &old[i]);
+    free(old);
+}
+
+// Pre-size the table for n points to avoid rehashing during a load.
+static inline void grid_reserve(NodeGrid *g, int n) {
+    int cap = 64;
+    while (cap < 2 * n) cap *= 2;
+    if (cap > g->cap) grid_resize(g, cap);
+}
+
+// Returns the id of a stored point within GRID_EPS on both axes, or -1.
+static inline int grid_find(const NodeGrid *g, double lat, double lon) {
+    if (g->count == 0) return -1;
+    int64_t cy = grid_cell(lat), cx = grid_cell(lon);
+    int best = -1;
+    for (int64_t y = cy - 1; y <= cy + 1; y++) {
+        for (int64_t x = cx - 1; x <= cx + 1; x++) {
+            uint64_t i = grid_hash(y, x) & (g->cap - 1);
+            for (; g->slot[i].id != -1; i = (i + 1) & (g->cap - 1)) {
+                const GridEntry *e = &g->slot[i];
+                if (e->cy != y || e->cx != x) continue;
+                if (fabs(e->lat - lat) < GRID_EPS && fabs(e->lon - lon) < GRID_EPS && (best == -1 || e->id < best)) best = e->id;
+            }
+        }
+    }
+    return best;
+}
+
+static inline void grid_insert(NodeGrid *g, double lat, double lon, int id) {
+    if (2 * (g->count + 1) > g->cap) grid_resize(g, g->cap ? g->cap * 2 : 64);
+    GridEntry e = { grid_cell(lat), grid_cell(lon), lat, lon, id };
+    grid_place(g, &e);
+    g->count++;
+}
+
+#endif
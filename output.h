@@ -0,0 +1,295 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include "graph.h"
+#include "route.h"
+
+// Result serialisation. Everything is appended to one growing OutBuf and written with a single
+// fwrite, and numbers go through out_fixed/out_time instead of printf, so a long path costs a
+// few microseconds. A found path is first laid out as a PathResult straight from prev and
+// prev_edge, which the directions, KML and GeoJSON writers all share. Its steps are also
+// coalesced into legs, one per stretch on the same vehicle: directions and GeoJSON list legs,
+// while KML keeps every vertex.
+
+typedef struct {
+    char *buf;
+    size_t len, cap;
+} OutBuf;
+
+static inline void out_reserve(OutBuf *o, size_t n) {
+    if (o->len + n <= o->cap) return;
+    while (o->len + n > o->cap) o->cap = o->cap ? o->cap * 2 : 4096;
+    o->buf = (char *)realloc(o->buf, o->cap);
+}
+
+static inline void out_bytes(OutBuf *o, const char *s, size_t n) {
+    out_reserve(o, n);
+    memcpy(o->buf + o->len, s, n);
+    o->len += n;
+}
+
+static inline void out_str(OutBuf *o, const char *s) { out_bytes(o, s, strlen(s)); }
+
+static inline void out_printf(OutBuf *o, const char *fmt, ...) {
+    va_list ap;
+    for (;;) {
+        va_start(ap, fmt);
+        int n = vsnprintf(o->buf + o->len, o->cap - o->len, fmt, ap);
+        va_end(ap);
+        if (n >= 0 && o->len + n < o->cap) { o->len += n; return; }
+        out_reserve(o, n >= 0 ? n + 1 : o->cap + 1);
+    }
+}
+
+// Unsigned v in at least width digits, zero padded.
+static inline void out_uint(OutBuf *o, unsigned long long v, int width) {
+    char tmp[24]; int n = 0;
+    do { tmp[n++] = (char)('0' + v % 10); v /= 10; } while (v);
+    while (n < width) tmp[n++] = '0';
+    out_reserve(o, n);
+    while (n) o->buf[o->len++] = tmp[--n];
+}
+
+// Same text as printf("%.*f", decimals, v). Scaling by a power of ten is exact to within one
+// rounding, which only matters when the scaled value sits next to a half; those, huge values
+// and non-finite ones go through printf.
+static inline void out_fixed(OutBuf *o, double v, int decimals) {
+    static const double scale[] = {1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+    double r = fabs(v) * (decimals >= 0 && decimals <= 9 ? scale[decimals] : 0);
+    if (decimals < 0 || decimals > 9 || !(r < 1e9) || fabs(r - floor(r) - 0.5) < 1e-6) { out_printf(o, "%.*f", decimals, v); return; }
+    unsigned long long n = (unsigned long long)(r + 0.5), p = (unsigned long long)scale[decimals];
+    if (signbit(v)) out_bytes(o, "-", 1);
+    out_uint(o, n / p, 1);
+    if (decimals) { out_bytes(o, ".", 1); out_uint(o, n % p, decimals); }
+}
+
+// Same text as format_time.
+static inline void out_time(OutBuf *o, double mins) {
+    int h = ((int)(mins / 60)) % 24, m = (int)fmod(mins, 60);
+    if (h < 0 || m < 0) { char t[20]; format_time(mins, t); out_str(o, t); return; }
+    out_uint(o, h % 12 == 0 ? 12 : h % 12, 2);
+    out_bytes(o, ":", 1);
+    out_uint(o, m, 2);
+    out_bytes(o, h >= 12 ? " PM" : " AM", 3);
+}
+
+// Writes the buffer to path and empties it; returns 0 when the file cannot be written.
+static inline int out_save(OutBuf *o, const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) return 0;
+    int ok = fwrite(o->buf, 1, o->len, fp) == o->len;
+    if (fclose(fp) != 0) ok = 0;
+    STAT_ADD(STAT_BYTES, o->len);
+    o->len = 0;
+    return ok;
+}
+
+static inline void out_free(OutBuf *o) {
+    free(o->buf);
+    o->buf = NULL; o->len = o->cap = 0;
+}
+
+// s as one JSON line: {"stats":"label","queries":N,"load_ms":..,...,"node_lookups":N,...}.
+static inline void out_stats(OutBuf *o, const char *label, const QueryStats *s) {
+    out_printf(o, "{\"stats\":\"%s\",\"queries\":%ld", label, s->queries);
+    for (int i = 0; i < PHASE_COUNT; i++) out_printf(o, ",\"%s_ms\":%.3f", stat_phase_names[i], s->ns[i] * 1e-6);
+    for (int i = 0; i < STAT_COUNT; i++) out_printf(o, ",\"%s\":%ld", stat_counter_names[i], s->count[i]);
+    out_str(o, "}\n");
+}
+
+// out_stats to fp; nothing unless built with ROUTE_STATS.
+static inline void stats_print(FILE *fp, const char *label, const QueryStats *s) {
+    if (!STATS_ENABLED) return;
+    OutBuf o = {0};
+    out_stats(&o, label, s);
+    fwrite(o.buf, 1, o.len, fp);
+    out_free(&o);
+}
+
+typedef struct {
+    int node, edge;         // edge is the one that reached node, -1 at the first node
+    double depart, arrive;  // boarding time on edge and arrival at node, minutes
+} PathStep;
+
+// Steps first..last (>= 1) ridden on one mode without leaving the vehicle; the leg starts at
+// step first - 1's node.
+typedef struct {
+    int first, last, mode;
+    double depart, arrive, cost, km;
+} PathLeg;
+
+typedef struct {
+    PathStep *steps;
+    int count, cap;
+    PathLeg *legs;
+    int leg_count, leg_cap;
+    double start_time, end_time;    // leaving the source point, reaching the destination point
+    double src_lat, src_lon, dst_lat, dst_lon;
+} PathResult;
+
+// Merges consecutive steps into legs. Steps on the same mode stay in one leg unless the next one
+// departs later than the previous arrival: on a timetable that is a change of trip, and without
+// one it is a headway wait charged at the node, which the directions must show rather than fold
+// into one long ride.
+static inline void path_coalesce(PathResult *pr, const Graph *g, const Mode *modes) {
+    if (pr->count > pr->leg_cap) {
+        pr->leg_cap = pr->count * 2;
+        pr->legs = (PathLeg *)realloc(pr->legs, pr->leg_cap * sizeof(PathLeg));
+    }
+    pr->leg_count = 0;
+    PathLeg *l = NULL;
+    for (int i = 1; i < pr->count; i++) {
+        const PathStep *s = &pr->steps[i];
+        int mode = g->mode[s->edge];
+        if (!l || l->mode != mode || s->depart > l->arrive + 1e-9) {
+            l = &pr->legs[pr->leg_count++];
+            l->first = i; l->mode = mode; l->depart = s->depart; l->cost = 0; l->km = 0;
+        }
+        l->last = i; l->arrive = s->arrive;
+        l->cost += g->dist[s->edge] * modes[mode].cost_rate; l->km += g->dist[s->edge];
+    }
+}
+
+// Lays out the path ws found to target. With scheduled set the rides follow a timetable
+// (raptor_search, pareto_pick) and an edge departs its ride time before its arrival; otherwise
+// it departs after mode_wait at its tail, as route_search charges it.
+static inline int path_build(PathResult *pr, const Graph *g, const Mode *modes, const Workspace *ws, int target, int scheduled) {
+    int count = 0;
+    for (int v = target; v != -1; v = ws->prev[v]) count++;
+    if (count > pr->cap) {
+        pr->cap = count * 2;
+        pr->steps = (PathStep *)realloc(pr->steps, pr->cap * sizeof(PathStep));
+    }
+    pr->count = count;
+    for (int v = target, i = count - 1; v != -1; v = ws->prev[v], i--) {
+        PathStep *s = &pr->steps[i];
+        int e = ws->prev[v] == -1 ? -1 : ws->prev_edge[v];
+        s->node = v; s->edge = e; s->arrive = ws->time_at[v];
+        if (e < 0) { s->depart = s->arrive; continue; }
+        const Mode *m = &modes[g->mode[e]];
+        double tail = ws->time_at[ws->prev[v]];
+        s->depart = scheduled ? s->arrive - graph_ride_min(g, m, e) : tail + mode_wait(m, tail);
+    }
+    path_coalesce(pr, g, modes);
+    return count;
+}
+
+// Sets the query points and the times the trip leaves the source and reaches the destination.
+static inline void path_set_ends(PathResult *pr, double sLat, double sLon, double dLat, double dLon, double start_time, double exit_walk) {
+    pr->src_lat = sLat; pr->src_lon = sLon; pr->dst_lat = dLat; pr->dst_lon = dLon;
+    pr->start_time = start_time;
+    pr->end_time = (pr->count ? pr->steps[pr->count - 1].arrive : start_time) + exit_walk;
+}
+
+static inline void path_free(PathResult *pr) {
+    free(pr->steps); free(pr->legs);
+    pr->steps = NULL; pr->count = pr->cap = 0;
+    pr->legs = NULL; pr->leg_count = pr->leg_cap = 0;
+}
+
+static inline void out_point(OutBuf *o, double a, double b) {
+    out_bytes(o, "(", 1); out_fixed(o, a, 6); out_bytes(o, ", ", 2); out_fixed(o, b, 6); out_bytes(o, ")", 1);
+}
+
+static inline void out_leg(OutBuf *o, double from, double to, double cost) {
+    out_time(o, from); out_bytes(o, " - ", 3); out_time(o, to);
+    out_str(o, ", Cost: BDT "); out_fixed(o, cost, 2); out_bytes(o, ": ", 2);
+}
+
+// One line per leg: the walk to the first node, every ride, the walk to the destination.
+static inline void path_write_directions(OutBuf *o, const Graph *g, const Mode *modes, const PathResult *pr) {
+    const Coord *first = &g->nodes[pr->steps[0].node], *last = &g->nodes[pr->steps[pr->count - 1].node];
+    out_leg(o, pr->start_time, pr->steps[0].arrive, 0);
+    out_str(o, "Walk from Source "); out_point(o, pr->src_lon, pr->src_lat);
+    out_str(o, " to "); out_point(o, first->lon, first->lat); out_str(o, ".\n\n");
+    for (int i = 0; i < pr->leg_count; i++) {
+        const PathLeg *l = &pr->legs[i];
+        const Coord *a = &g->nodes[pr->steps[l->first - 1].node], *b = &g->nodes[pr->steps[l->last].node];
+        out_leg(o, l->depart, l->arrive, l->cost);
+        out_str(o, "Ride "); out_str(o, modes[l->mode].name); out_str(o, " from "); out_point(o, a->lon, a->lat);
+        out_str(o, " to "); out_point(o, b->lon, b->lat); out_str(o, ".\n\n");
+    }
+    out_leg(o, pr->steps[pr->count - 1].arrive, pr->end_time, 0);
+    out_str(o, "Walk from "); out_point(o, last->lon, last->lat);
+    out_str(o, " to Destination "); out_point(o, pr->dst_lon, pr->dst_lat); out_str(o, ".\n");
+}
+
+static inline void out_coord(OutBuf *o, double lon, double lat, const char *end) {
+    out_fixed(o, lon, 6); out_bytes(o, ",", 1); out_fixed(o, lat, 6); out_str(o, end);
+}
+
+// The shape points a simplified graph dropped from edge e out of u, each between pre and end.
+static inline void out_shape(OutBuf *o, const Graph *g, int u, int e, const char *pre, const char *end) {
+    if (!g->shape_off || e < 0) return;
+    ShapeCursor c; Coord p;
+    graph_shape_begin(g, u, e, &c);
+    while (graph_shape_next(&c, &p)) { out_str(o, pre); out_coord(o, p.lon, p.lat, end); }
+}
+
+// The whole trip as one KML line string, query points included.
+static inline void path_write_kml(OutBuf *o, const Graph *g, const PathResult *pr) {
+    out_str(o, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<kml xmlns=\"http://www.opengis.net/kml/2.2\">\n<Document><Placemark><LineString><coordinates>\n");
+    out_coord(o, pr->src_lon, pr->src_lat, ",0\n");
+    for (int i = 1; i < pr->count; i++) {
+        out_shape(o, g, pr->steps[i - 1].node, pr->steps[i].edge, "", ",0\n");
+        out_coord(o, g->nodes[pr->steps[i].node].lon, g->nodes[pr->steps[i].node].lat, ",0\n");
+    }
+    out_coord(o, pr->dst_lon, pr->dst_lat, ",0\n");
+    out_str(o, "</coordinates></LineString></Placemark></Document></kml>");
+}
+
+// A FeatureCollection: the whole trip as one line string with its totals, then one feature per
+// leg with its mode, distance, cost, times and full geometry.
+static inline void path_write_geojson(OutBuf *o, const Graph *g, const Mode *modes, const PathResult *pr) {
+    double cost = 0, km = 0;
+    for (int i = 0; i < pr->leg_count; i++) { cost += pr->legs[i].cost; km += pr->legs[i].km; }
+    out_str(o, "{\"type\":\"FeatureCollection\",\"features\":[\n{\"type\":\"Feature\",\"properties\":{\"distance_km\":");
+    out_fixed(o, km, 3); out_str(o, ",\"cost_bdt\":"); out_fixed(o, cost, 2);
+    out_str(o, ",\"depart\":\""); out_time(o, pr->start_time); out_str(o, "\",\"arrive\":\""); out_time(o, pr->end_time);
+    out_str(o, "\"},\"geometry\":{\"type\":\"LineString\",\"coordinates\":[[");
+    out_coord(o, pr->src_lon, pr->src_lat, "]");
+    for (int i = 0; i < pr->count; i++) {
+        if (i > 0) out_shape(o, g, pr->steps[i - 1].node, pr->steps[i].edge, ",[", "]");
+        out_str(o, ",["); out_coord(o, g->nodes[pr->steps[i].node].lon, g->nodes[pr->steps[i].node].lat, "]");
+    }
+    out_str(o, ",["); out_coord(o, pr->dst_lon, pr->dst_lat, "]]}}");
+    for (int i = 0; i < pr->leg_count; i++) {
+        const PathLeg *l = &pr->legs[i];
+        out_str(o, ",\n{\"type\":\"Feature\",\"properties\":{\"mode\":\""); out_str(o, modes[l->mode].name);
+        out_str(o, "\",\"distance_km\":"); out_fixed(o, l->km, 3);
+        out_str(o, ",\"cost_bdt\":"); out_fixed(o, l->cost, 2);
+        out_str(o, ",\"depart\":\""); out_time(o, l->depart); out_str(o, "\",\"arrive\":\""); out_time(o, l->arrive);
+        out_str(o, "\"},\"geometry\":{\"type\":\"LineString\",\"coordinates\":[");
+        for (int k = l->first - 1; k <= l->last; k++) {
+            const Coord *c = &g->nodes[pr->steps[k].node];
+            if (k > l->first - 1) out_shape(o, g, pr->steps[k - 1].node, pr->steps[k].edge, ",[", "]");
+            out_str(o, k == l->first - 1 ? "[" : ",["); out_coord(o, c->lon, c->lat, "]");
+        }
+        out_str(o, "]}}");
+    }
+    out_str(o, "\n]}\n");
+}
+
+// Writes name_directions.txt, name.kml and name.geojson; returns 0 if any cannot be written.
+static inline int path_save(const Graph *g, const Mode *modes, const PathResult *pr, const char *name) {
+    OutBuf o = {0};
+    char path[256];
+    int ok = 1;
+    STAT_BEGIN(PHASE_OUTPUT);
+    path_write_directions(&o, g, modes, pr);
+    snprintf(path, sizeof(path), "%s_directions.txt", name); ok &= out_save(&o, path);
+    path_write_kml(&o, g, pr);
+    snprintf(path, sizeof(path), "%s.kml", name); ok &= out_save(&o, path);
+    path_write_geojson(&o, g, modes, pr);
+    snprintf(path, sizeof(path), "%s.geojson", name); ok &= out_save(&o, path);
+    out_free(&o);
+    STAT_END(PHASE_OUTPUT);
+    return ok;
+}
+
+#endif
@@ -0,0 +1,312 @@
+#ifndef PARETO_H
+#define PARETO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "graph.h"
+#include "route.h"
+#include "transit.h"
+
+// Multi-criteria search over the timetable model: every journey that is not beaten on all of
+// arrival time, BDT cost and transfers at once, in a single pass. A distance query adds the
+// kilometres as a fourth criterion, so the shortest journey is on the frontier too.
+// Each node keeps a bag of labels, none of which dominates another, chained through the label
+// array so a bag holds as many as the trade-offs need; a label that is dominated on arrival (or
+// by a journey already at the destination) is dropped, and one that dominates older labels
+// evicts them. Labels are settled in order of arrival time
+// from a radix heap, since every move only moves the clock forward. Moves are the unscheduled
+// edges (car), charged per km, and rides: boarding the earliest catchable trip of a route and
+// leaving it at any later stop, which counts one boarding.
+// A query with landmark tables (cost and time) also drops a label when even the least time and
+// fare still to go would miss the deadline or be dominated by a journey already found.
+// pareto_search fills the workspace's frontier with the journeys that reach a destination point
+// by the deadline, exit walk included; pareto_pick chooses one of them by objective and lays it
+// out in the Workspace like any other search. Without a destination every node's bag is kept
+// for pareto_best.
+
+typedef struct {
+    double time, cost, dist;
+    int boardings;
+    int node, parent;   // parent label, -1 at a seed
+    int next;           // next label in node's bag, -1 at the end
+    int board, via;     // ride from slot board to slot via, or edge via when board is -1
+    int dead;           // evicted by a dominating label
+} ParetoLabel;
+
+// A journey on the frontier: a destination label plus the exit walk.
+typedef struct {
+    int label;
+    double arrive, cost, dist;
+    int transfers;
+} ParetoJourney;
+
+typedef struct {
+    ParetoLabel *labels;
+    int label_count, label_cap;
+    int *bag;           // per node: first label of its bag, -1 when empty
+    unsigned *bag_gen, gen;
+    RadixHeap queue;
+    ParetoJourney *frontier;
+    int frontier_count, frontier_cap;
+    int *path_node, *path_edge, path_cap;
+    double *path_time;
+    double *bound_time, *bound_cost;    // per node: landmark bounds to the nearest exit
+    unsigned *bound_gen;
+} ParetoWorkspace;
+
+static inline void pareto_init(ParetoWorkspace *pw, int n) {
+    memset(pw, 0, sizeof(*pw));
+    size_t cap = n > 0 ? n : 1;
+    pw->bag = (int *)malloc(cap * sizeof(int));
+    pw->bag_gen = (unsigned *)calloc(cap, sizeof(unsigned));
+    pw->bound_time = (double *)malloc(cap * sizeof(double));
+    pw->bound_cost = (double *)malloc(cap * sizeof(double));
+    pw->bound_gen = (unsigned *)calloc(cap, sizeof(unsigned));
+    radix_init(&pw->queue);
+}
+
+static inline void pareto_free(ParetoWorkspace *pw) {
+    free(pw->labels); free(pw->bag); free(pw->bag_gen);
+    radix_free(&pw->queue);
+    free(pw->frontier); free(pw->path_node); free(pw->path_edge); free(pw->path_time);
+    free(pw->bound_time); free(pw->bound_cost); free(pw->bound_gen);
+    memset(pw, 0, sizeof(*pw));
+}
+
+// d1 and d2 are the distances for a distance query and 0 otherwise.
+static inline int pareto_dominates(double t1, double c1, int b1, double d1, double t2, double c2, int b2, double d2) {
+    return t1 <= t2 && c1 <= c2 && b1 <= b2 && d1 <= d2;
+}
+
+typedef struct {
+    const Graph *g;
+    const Mode *modes;
+    const Timetable *tt;
+    ParetoWorkspace *pw;
+    const Query *q;
+    double by_dist;     // 1 when distance is a criterion, else 0
+} Pareto;
+
+// Least time and fare from v to any exit by the query's landmark tables, once per node and query.
+static inline void pareto_bound(Pareto *p, int v, double *time, double *cost) {
+    ParetoWorkspace *pw = p->pw; const Query *q = p->q;
+    if (pw->bound_gen[v] != pw->gen) {
+        double bt = INF, bc = INF;
+        for (int i = 0; i < (q->exit_count ? q->exit_count : 1); i++) {
+            int t = q->exit_count ? q->exits[i].node : q->dst;
+            if (t < 0) { bt = bc = 0; break; }
+            double lt = landmarks_bound(q->landmarks, OBJ_TIME, v, t), lc = landmarks_bound(q->landmarks, OBJ_COST, v, t);
+            if (lt < bt) bt = lt;
+            if (lc < bc) bc = lc;
+        }
+        pw->bound_gen[v] = pw->gen; pw->bound_time[v] = bt; pw->bound_cost[v] = bc;
+    }
+    *time = pw->bound_time[v]; *cost = pw->bound_cost[v];
+}
+
+// True when even the least time and fare still to go from v would miss the deadline or be
+// dominated by a journey already found.
+static inline int pareto_hopeless(Pareto *p, int v, double t, double cost, int boardings) {
+    ParetoWorkspace *pw = p->pw;
+    double lt, lc;
+    pareto_bound(p, v, &lt, &lc);
+    if (t + lt > p->q->deadline) return 1;
+    for (int i = 0; i < pw->frontier_count; i++) {
+        const ParetoJourney *j = &pw->frontier[i];
+        if (pareto_dominates(j->arrive, j->cost, j->transfers, j->dist * p->by_dist, t + lt, cost + lc, boardings > 1 ? boardings - 1 : 0, 0)) return 1;
+    }
+    return 0;
+}
+
+// Adds a label at v unless the deadline, the frontier or v's bag rules it out. A hopeless label
+// still evicts the labels it dominates, so bags never hold more than they would without bounds.
+static inline void pareto_offer(Pareto *p, int v, double t, double cost, double dist, int boardings, int parent, int board, int via) {
+    ParetoWorkspace *pw = p->pw;
+    double d = dist * p->by_dist;
+    if (t > p->q->deadline) return;
+    for (int i = 0; i < pw->frontier_count; i++) {
+        const ParetoJourney *j = &pw->frontier[i];
+        if (pareto_dominates(j->arrive, j->cost, j->transfers, j->dist * p->by_dist, t, cost, boardings > 1 ? boardings - 1 : 0, d)) return;
+    }
+    if (pw->bag_gen[v] != pw->gen) { pw->bag_gen[v] = pw->gen; pw->bag[v] = -1; }
+    for (int i = pw->bag[v]; i >= 0; i = pw->labels[i].next) {
+        const ParetoLabel *o = &pw->labels[i];
+        if (pareto_dominates(o->time, o->cost, o->boardings, o->dist * p->by_dist, t, cost, boardings, d)) return;
+    }
+    for (int *link = &pw->bag[v]; *link >= 0; ) {
+        ParetoLabel *o = &pw->labels[*link];
+        if (pareto_dominates(t, cost, boardings, d, o->time, o->cost, o->boardings, o->dist * p->by_dist)) { o->dead = 1; *link = o->next; }
+        else link = &o->next;
+    }
+    if (p->q->landmarks && pareto_hopeless(p, v, t, cost, boardings)) return;
+    if (pw->label_count == pw->label_cap) {
+        pw->label_cap = pw->label_cap ? pw->label_cap * 2 : 4096;
+        pw->labels = (ParetoLabel *)realloc(pw->labels, pw->label_cap * sizeof(ParetoLabel));
+    }
+    int id = pw->label_count++;
+    ParetoLabel *l = &pw->labels[id];
+    l->time = t; l->cost = cost; l->dist = dist; l->boardings = boardings;
+    l->node = v; l->parent = parent; l->board = board; l->via = via; l->dead = 0;
+    l->next = pw->bag[v]; pw->bag[v] = id;
+    radix_push(&pw->queue, t, id);
+}
+
+// Records a settled label at an exit on the frontier, dropping the journeys it dominates,
+// unless the exit walk makes it miss the deadline.
+static inline void pareto_arrive(Pareto *p, int id, double walk) {
+    ParetoWorkspace *pw = p->pw;
+    const ParetoLabel *l = &pw->labels[id];
+    double arrive = l->time + walk, d = l->dist * p->by_dist;
+    int transfers = l->boardings > 1 ? l->boardings - 1 : 0, k = 0;
+    if (arrive > p->q->deadline) return;
+    for (int i = 0; i < pw->frontier_count; i++) {
+        const ParetoJourney *j = &pw->frontier[i];
+        if (pareto_dominates(j->arrive, j->cost, j->transfers, j->dist * p->by_dist, arrive, l->cost, transfers, d)) return;
+    }
+    for (int i = 0; i < pw->frontier_count; i++) {
+        const ParetoJourney *j = &pw->frontier[i];
+        if (!pareto_dominates(arrive, l->cost, transfers, d, j->arrive, j->cost, j->transfers, j->dist * p->by_dist)) pw->frontier[k++] = *j;
+    }
+    pw->frontier_count = k;
+    if (pw->frontier_count == pw->frontier_cap) {
+        pw->frontier_cap = pw->frontier_cap ? pw->frontier_cap * 2 : 16;
+        pw->frontier = (ParetoJourney *)realloc(pw->frontier, pw->frontier_cap * sizeof(ParetoJourney));
+    }
+    ParetoJourney *j = &pw->frontier[pw->frontier_count++];
+    j->label = id; j->arrive = arrive; j->cost = l->cost; j->dist = l->dist; j->transfers = transfers;
+}
+
+static inline void pareto_expand(Pareto *p, int id) {
+    const Graph *g = p->g; const Timetable *tt = p->tt; ParetoWorkspace *pw = p->pw;
+    ParetoLabel l = pw->labels[id];
+    int u = l.node;
+    STAT_ADD(STAT_RELAXED, g->off[u+1] - g->off[u]);
+    for (int e = g->off[u]; e < g->off[u+1]; e++) {
+        const Mode *m = &p->modes[g->mode[e]];
+        if (!(p->q->mode_mask & (1u << g->mode[e])) || m->interval != 0 || graph_factor(g, e) == 0) continue;
+        pareto_offer(p, g->to[e], l.time + graph_ride_min(g, m, e), l.cost + g->dist[e] * m->cost_rate,
+                     l.dist + g->dist[e], l.boardings, id, -1, e);
+    }
+    for (int k = tt->node_off[u]; k < tt->node_off[u+1]; k++) {
+        int s = tt->node_slot[k];
+        const TransitRoute *route = &tt->routes[tt->slot_route[s]];
+        const Mode *m = &p->modes[route->mode];
+        if (!(p->q->mode_mask & (1u << route->mode)) || m->interval == 0) continue;
+        // Staying on board is covered by the ride that brought the label here.
+        if (l.board >= 0 && tt->slot_route[l.board] == tt->slot_route[s]) continue;
+        double dep = timetable_trip(m, timetable_offset(m, tt->slot_km[s]), l.time);
+        if (dep < 0) continue;
+        for (int j = s + 1; j < route->first + route->count; j++) {
+            double t = dep + timetable_offset(m, tt->slot_km[j]);
+            if (t > p->q->deadline) break;
+            STAT_ADD(STAT_RELAXED, 1);
+            double km = tt->slot_km[j] - tt->slot_km[s];
+            pareto_offer(p, tt->slot_node[j], t, l.cost + km * m->cost_rate, l.dist + km, l.boardings + 1, id, s, j);
+        }
+    }
+}
+
+// Fills pw->frontier with every non-dominated journey from q's entries (or src) to its exits
+// (or dst), one per (arrival, cost, transfers) trade-off, in no particular order. Arrivals
+// include the exit walk and the deadline bounds them, as well as the arrival at every node.
+// Returns the frontier size.
+static inline int pareto_search(const Graph *g, const Mode *modes, const Timetable *tt, Workspace *ws, ParetoWorkspace *pw, const Query *q) {
+    Pareto p = { g, modes, tt, pw, q, q->objective == OBJ_DISTANCE ? 1.0 : 0.0 };
+    if (++pw->gen == 0) {
+        memset(pw->bag_gen, 0, (g->node_count ? g->node_count : 1) * sizeof(unsigned));
+        memset(pw->bound_gen, 0, (g->node_count ? g->node_count : 1) * sizeof(unsigned));
+        pw->gen = 1;
+    }
+    pw->label_count = 0; pw->frontier_count = 0;
+    ws->settled = 0; ws->target = -1;
+    int seeds = q->entry_count ? q->entry_count : 1;
+    for (int i = 0; i < seeds; i++) {
+        int s = q->entry_count ? q->entries[i].node : q->src;
+        pareto_offer(&p, s, q->start_time + (q->entry_count ? q->entries[i].walk_min : 0), 0, 0, 0, -1, -1, -1);
+    }
+    while (!radix_empty(&pw->queue)) {
+        double t;
+        int id = radix_pop(&pw->queue, &t);
+        if (pw->labels[id].dead) continue;
+        ws->settled++;
+        int v = pw->labels[id].node;
+        if (!q->exit_count) {
+            if (v == q->dst) pareto_arrive(&p, id, 0);
+        } else {
+            for (int i = 0; i < q->exit_count; i++) if (q->exits[i].node == v) pareto_arrive(&p, id, q->exits[i].walk_min);
+        }
+        pareto_expand(&p, id);
+    }
+    return pw->frontier_count;
+}
+
+// The label at v best on objective o (earliest first among equals) after a search without a
+// destination, or -1 when v was not reached.
+static inline int pareto_best(const ParetoWorkspace *pw, int v, Objective o) {
+    int best = -1;
+    if (pw->bag_gen[v] != pw->gen) return -1;
+    for (int i = pw->bag[v]; i >= 0; i = pw->labels[i].next) {
+        const ParetoLabel *l = &pw->labels[i], *b = best >= 0 ? &pw->labels[best] : NULL;
+        double key = objective_total(o, l->time, l->cost, l->dist);
+        double bkey = !b ? INF : objective_total(o, b->time, b->cost, b->dist);
+        if (key < bkey || (b && key == bkey && l->time < b->time)) best = i;
+    }
+    return best;
+}
+
+// Picks the frontier journey that is best on q->objective (the cheapest for OBJ_COST, the
+// earliest for OBJ_TIME, the shortest for OBJ_DISTANCE; every one is on time), lays it out in
+// ws as a node path with running totals, and returns its frontier index, or -1 if there is none.
+static inline int pareto_pick(const Graph *g, const Mode *modes, const Timetable *tt, Workspace *ws, ParetoWorkspace *pw, const Query *q) {
+    int best = -1;
+    for (int i = 0; i < pw->frontier_count; i++) {
+        const ParetoJourney *j = &pw->frontier[i], *b = best >= 0 ? &pw->frontier[best] : NULL;
+        double key = objective_total(q->objective, j->arrive, j->cost, j->dist);
+        double bkey = !b ? INF : objective_total(q->objective, b->arrive, b->cost, b->dist);
+        if (key < bkey || (b && key == bkey && j->arrive < b->arrive)) best = i;
+    }
+    if (best < 0) return -1;
+
+    // Collect the journey back to front, expanding rides into their stops.
+    workspace_next(ws);
+    int count = 0;
+    for (int id = pw->frontier[best].label; id >= 0; id = pw->labels[id].parent) {
+        const ParetoLabel *l = &pw->labels[id];
+        int need = count + (l->board >= 0 ? l->via - l->board : 1);
+        if (need > pw->path_cap) {
+            pw->path_cap = need * 2;
+            pw->path_node = (int *)realloc(pw->path_node, pw->path_cap * sizeof(int));
+            pw->path_edge = (int *)realloc(pw->path_edge, pw->path_cap * sizeof(int));
+            pw->path_time = (double *)realloc(pw->path_time, pw->path_cap * sizeof(double));
+        }
+        if (l->board >= 0) {
+            const Mode *m = &modes[tt->routes[tt->slot_route[l->via]].mode];
+            double dep = l->time - timetable_offset(m, tt->slot_km[l->via]);
+            for (int s = l->via; s > l->board; s--) {
+                pw->path_node[count] = tt->slot_node[s]; pw->path_edge[count] = tt->slot_edge[s];
+                pw->path_time[count++] = dep + timetable_offset(m, tt->slot_km[s]);
+            }
+        } else {
+            pw->path_node[count] = l->node; pw->path_edge[count] = l->via; pw->path_time[count++] = l->time;
+        }
+    }
+    // A dominated label never survives, so a kept journey cannot pass a node twice; the check
+    // only keeps a broken path from looping prev.
+    int prev = -1;
+    for (int i = count - 1; i >= 0; i--) {
+        int v = pw->path_node[i], e = pw->path_edge[i];
+        if (ws->seen[v] == ws->gen) return -1;
+        ws->prev[v] = prev; ws->prev_edge[v] = e; ws->seen[v] = ws->gen;
+        ws->time_at[v] = pw->path_time[i];
+        ws->cost_at[v] = e < 0 ? 0 : ws->cost_at[prev] + g->dist[e] * modes[g->mode[e]].cost_rate;
+        ws->dist_at[v] = e < 0 ? 0 : ws->dist_at[prev] + g->dist[e];
+        ws->key[v] = objective_total(q->objective, ws->time_at[v], ws->cost_at[v], ws->dist_at[v]);
+        prev = v;
+    }
+    ws->target = prev;
+    return best;
+}
+
+#endif
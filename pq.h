@@ -0,0 +1,175 @@
+#ifndef PQ_H
+#define PQ_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "stats.h"
+
+// Priority queues shared by the solvers.
+//   IndexedHeap: binary min-heap over node ids with decrease-key (any non-negative key).
+//   RadixHeap:   monotone heap for searches whose popped keys never go down (arrival times).
+
+typedef struct {
+    int *heap;      // heap slot -> node
+    int *pos;       // node -> heap slot, -1 when not queued
+    double *key;    // node -> key
+    int size, cap;
+} IndexedHeap;
+
+static inline void heap_init(IndexedHeap *h, int cap) {
+    h->heap = (int *)malloc(cap * sizeof(int));
+    h->pos = (int *)malloc(cap * sizeof(int));
+    h->key = (double *)malloc(cap * sizeof(double));
+    memset(h->pos, -1, cap * sizeof(int));
+    h->size = 0; h->cap = cap;
+}
+
+static inline void heap_free(IndexedHeap *h) {
+    free(h->heap); free(h->pos); free(h->key);
+    h->heap = h->pos = NULL; h->key = NULL; h->size = h->cap = 0;
+}
+
+static inline int heap_empty(const IndexedHeap *h) { return h->size == 0; }
+
+static inline double heap_top_key(const IndexedHeap *h) { return h->key[h->heap[0]]; }
+
+// Drops all queued nodes in O(size), leaving the heap ready for another search.
+static inline void heap_clear(IndexedHeap *h) {
+    for (int i = 0; i < h->size; i++) h->pos[h->heap[i]] = -1;
+    h->size = 0;
+}
+
+static inline void heap_sift_up(IndexedHeap *h, int i) {
+    int v = h->heap[i]; double k = h->key[v];
+    while (i > 0) {
+        int p = (i - 1) / 2;
+        if (h->key[h->heap[p]] <= k) break;
+        h->heap[i] = h->heap[p]; h->pos[h->heap[i]] = i;
+        i = p;
+    }
+    h->heap[i] = v; h->pos[v] = i;
+}
+
+static inline void heap_sift_down(IndexedHeap *h, int i) {
+    int v = h->heap[i]; double k = h->key[v];
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= h->size) break;
+        if (c + 1 < h->size && h->key[h->heap[c+1]] < h->key[h->heap[c]]) c++;
+        if (h->key[h->heap[c]] >= k) break;
+        h->heap[i] = h->heap[c]; h->pos[h->heap[i]] = i;
+        i = c;
+    }
+    h->heap[i] = v; h->pos[v] = i;
+}
+
+// Insert v, or lower its key if it is already queued.
+static inline void heap_push(IndexedHeap *h, int v, double k) {
+    STAT_ADD(STAT_PUSHES, 1);
+    if (h->pos[v] == -1) {
+        h->key[v] = k;
+        h->heap[h->size] = v; h->pos[v] = h->size;
+        heap_sift_up(h, h->size++);
+    } else if (k < h->key[v]) {
+        h->key[v] = k;
+        heap_sift_up(h, h->pos[v]);
+    }
+}
+
+// Sets the key of a queued v in either direction, or pushes it.
+static inline void heap_update(IndexedHeap *h, int v, double k) {
+    if (h->pos[v] == -1 || k < h->key[v]) { heap_push(h, v, k); return; }
+    h->key[v] = k;
+    heap_sift_down(h, h->pos[v]);
+}
+
+static inline int heap_pop(IndexedHeap *h) {
+    STAT_ADD(STAT_POPS, 1);
+    int v = h->heap[0];
+    h->pos[v] = -1;
+    if (--h->size > 0) {
+        h->heap[0] = h->heap[h->size]; h->pos[h->heap[0]] = 0;
+        heap_sift_down(h, 0);
+    }
+    return v;
+}
+
+// Radix heap. Non-negative doubles order the same way as their IEEE-754 bit patterns
+// read as unsigned integers, so minute-valued arrival times are bucketed exactly by the
+// highest bit in which they differ from the last popped key. No decrease-key: callers
+// push duplicates and skip stale entries on pop.
+typedef struct {
+    uint64_t key;
+    int node;
+} RadixItem;
+
+typedef struct {
+    RadixItem *items;
+    int size, cap;
+} RadixBucket;
+
+typedef struct {
+    RadixBucket bucket[65];
+    uint64_t last;
+    int size;
+} RadixHeap;
+
+static inline uint64_t radix_bits(double k) { uint64_t b; memcpy(&b, &k, sizeof(b)); return b; }
+
+static inline double radix_value(uint64_t b) { double k; memcpy(&k, &b, sizeof(k)); return k; }
+
+static inline int radix_index(uint64_t k, uint64_t last) {
+    return k == last ? 0 : 64 - __builtin_clzll(k ^ last);
+}
+
+static inline void radix_init(RadixHeap *h) { memset(h, 0, sizeof(*h)); }
+
+static inline void radix_free(RadixHeap *h) {
+    for (int i = 0; i < 65; i++) free(h->bucket[i].items);
+    memset(h, 0, sizeof(*h));
+}
+
+static inline int radix_empty(const RadixHeap *h) { return h->size == 0; }
+
+// Empties the heap but keeps bucket storage; the next search may start from any key.
+static inline void radix_clear(RadixHeap *h) {
+    for (int i = 0; i < 65; i++) h->bucket[i].size = 0;
+    h->last = 0; h->size = 0;
+}
+
+static inline void radix_put(RadixHeap *h, uint64_t k, int v) {
+    RadixBucket *b = &h->bucket[radix_index(k, h->last)];
+    if (b->size >= b->cap) {
+        b->cap = b->cap ? b->cap * 2 : 16;
+        b->items = (RadixItem *)realloc(b->items, b->cap * sizeof(RadixItem));
+    }
+    b->items[b->size].key = k; b->items[b->size++].node = v;
+}
+
+// k must be >= the last popped key.
+static inline void radix_push(RadixHeap *h, double k, int v) {
+    STAT_ADD(STAT_PUSHES, 1);
+    radix_put(h, radix_bits(k), v);
+    h->size++;
+}
+
+static inline int radix_pop(RadixHeap *h, double *k) {
+    STAT_ADD(STAT_POPS, 1);
+    if (h->bucket[0].size == 0) {
+        int i = 1;
+        while (h->bucket[i].size == 0) i++;
+        RadixBucket *b = &h->bucket[i];
+        uint64_t m = b->items[0].key;
+        for (int j = 1; j < b->size; j++) if (b->items[j].key < m) m = b->items[j].key;
+        h->last = m;
+        int n = b->size; b->size = 0;
+        for (int j = 0; j < n; j++) radix_put(h, b->items[j].key, b->items[j].node);
+    }
+    RadixBucket *b0 = &h->bucket[0];
+    h->size--;
+    *k = radix_value(h->last);
+    return b0->items[--b0->size].node;
+}
+
+#endif
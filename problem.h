@@ -0,0 +1,334 @@
+#ifndef PROBLEM_H
+#define PROBLEM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "graph.h"
+#include "route.h"
+#include "output.h"
+#include "kdtree.h"
+#include "snapshot.h"
+#include "ch.h"
+#include "transit.h"
+#include "pareto.h"
+
+// The six contest problems as data. Each transport is one CSV; each problem picks transports and
+// gives them its own fare, speed and schedule, and names the objective it minimises. Graph
+// loading, snapping, the search and the output files all live here, so problemN.c only asks for
+// the input and prints its summary, and the server, batch runner and matrix share this table.
+// The search follows the objective: raptor_search for time, the Pareto search when there is a
+// deadline or a scheduled mode (so a wait is only paid when boarding), otherwise route_search
+// (or the contraction hierarchy when the front-end loaded one).
+// Transports and each problem's modes are read from MODES_CONF at startup (format in that file),
+// so fares, schedules and new operators need no rebuild; without the file the built-in table
+// below, which holds the same values, is used. The file is stamped into every snapshot, so an
+// edit also recompiles the graph.
+
+#define MODES_CONF "modes.conf"
+#define MAX_TRANSPORTS 7    // a snapshot stamps every CSV plus MODES_CONF
+
+typedef struct {
+    char name[32];          // as the shared graph calls it
+    char path[128];
+    int two_way;            // road network: every segment runs both ways
+    int required;           // loading fails without it
+} Transport;
+
+static Transport transports[MAX_TRANSPORTS] = {
+    {"Car", "Roadmap-Dhaka.csv", 1, 1},
+    {"Metro", "Routemap-DhakaMetroRail.csv", 0, 0},
+    {"Bikolpo Bus", "Routemap-BikolpoBus.csv", 0, 0},
+    {"Uttara Bus", "Routemap-UttaraBus.csv", 0, 0},
+};
+static int transport_count = 4;
+static int modes_from_file;     // set once MODES_CONF has replaced the built-in table
+
+typedef struct {
+    char name[32];          // shown in directions; empty ends a problem's list
+    int transport;
+    double rate, speed, interval;
+    int start_h, end_h;
+} ModeSpec;
+
+typedef struct {
+    Objective objective;
+    int start_time;     // minutes; -1 when the request must supply it
+    int needs_deadline;
+    ModeSpec modes[MAX_TRANSPORTS];  // modes the problem may use, in mode id order
+} ProblemSpec;
+
+static ProblemSpec problems[6] = {
+    { OBJ_DISTANCE, 9 * 60, 0, { {"Car", 0, 20.0, 30.0, 0, 0, 24} } },
+    { OBJ_COST, 8 * 60, 0, { {"Car", 0, 20.0, 30.0, 0, 0, 24}, {"Metro", 1, 5.0, 30.0, 0, 0, 24} } },
+    { OBJ_COST, 8 * 60, 0, { {"Car", 0, 20.0, 30.0, 0, 0, 24}, {"Metro", 1, 5.0, 30.0, 0, 0, 24},
+                             {"Bikolpo Bus", 2, 7.0, 30.0, 0, 0, 24}, {"Uttara Bus", 3, 7.0, 30.0, 0, 0, 24} } },
+    // Transit runs every 15 minutes from 6 AM to 11 PM
+    { OBJ_COST, -1, 0, { {"Car", 0, 20.0, 30.0, 0, 0, 24}, {"Metro", 1, 5.0, 30.0, 15.0, 6, 23},
+                         {"Bikolpo Bus", 2, 7.0, 30.0, 15.0, 6, 23}, {"Uttara Bus", 3, 7.0, 30.0, 15.0, 6, 23} } },
+    // Everything moves at 10 km/h; transit runs every 15 minutes, 6 AM to 10 PM
+    { OBJ_TIME, -1, 0, { {"Car", 0, 20.0, 10.0, 0, 0, 24}, {"Metro", 1, 5.0, 10.0, 15.0, 6, 22},
+                         {"Bikolpo Bus", 2, 7.0, 10.0, 15.0, 6, 22}, {"Uttara Bus", 3, 7.0, 10.0, 15.0, 6, 22} } },
+    { OBJ_COST, -1, 1, { {"Car", 0, 20.0, 20.0, 0, 0, 24}, {"Metro", 1, 5.0, 15.0, 5.0, 1, 23},
+                         {"Bikalpa Bus", 2, 7.0, 10.0, 20.0, 7, 22}, {"Uttara Bus", 3, 10.0, 12.0, 10.0, 6, 23} } },
+};
+
+// Number of modes in spec.
+static inline int problem_mode_count(const ProblemSpec *spec) {
+    int n = 0;
+    while (n < MAX_TRANSPORTS && spec->modes[n].name[0]) n++;
+    return n;
+}
+
+// Splits s in place at '|' into at most max trimmed fields; returns the count.
+static inline int modes_split(char *s, char **fields, int max) {
+    int n = 0;
+    for (char *f = s; f && n < max; ) {
+        char *bar = strchr(f, '|');
+        if (bar) *bar = '\0';
+        while (*f == ' ' || *f == '\t') f++;
+        char *e = f + strlen(f);
+        while (e > f && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\n' || e[-1] == '\r')) *--e = '\0';
+        fields[n++] = f;
+        f = bar ? bar + 1 : NULL;
+    }
+    return n;
+}
+
+static inline int modes_number(const char *s, double lo, double hi, double *out) {
+    char *end;
+    *out = strtod(s, &end);
+    return end != s && *end == '\0' && *out >= lo && *out <= hi;
+}
+
+// Replaces the built-in transports and problem modes with those in path, if it exists. Returns
+// 0, with a message, on a malformed file; the tables are then left half filled, so callers stop.
+static inline int modes_load(const char *path) {
+    static int loaded;
+    if (loaded) return 1;
+    FILE *fp = fopen(path, "r");
+    loaded = 1;
+    if (!fp) return 1;
+    transport_count = 0;
+    for (int p = 0; p < 6; p++) memset(problems[p].modes, 0, sizeof(problems[p].modes));
+    char line[512], *f[8];
+    const char *err = NULL;
+    int line_no = 0;
+    while (!err && fgets(line, sizeof(line), fp)) {
+        line_no++;
+        char *s = line + strspn(line, " \t\r\n");
+        if (*s == '\0' || *s == '#') continue;
+        if (strncmp(s, "transport ", 10) == 0) {
+            int n = modes_split(s + 10, f, 4);
+            if (n < 3 || (strcmp(f[2], "roads") != 0 && strcmp(f[2], "routes") != 0)) err = "expected: transport NAME | CSV | roads|routes [| required]";
+            else if (transport_count == MAX_TRANSPORTS) err = "too many transports";
+            else if (strlen(f[0]) >= sizeof(transports[0].name) || strlen(f[1]) >= sizeof(transports[0].path)) err = "name or path too long";
+            else {
+                Transport *t = &transports[transport_count++];
+                strcpy(t->name, f[0]); strcpy(t->path, f[1]);
+                t->two_way = strcmp(f[2], "roads") == 0;
+                t->required = n > 3 && strcmp(f[3], "required") == 0;
+            }
+        } else if (strncmp(s, "mode ", 5) == 0) {
+            double v[6];
+            int n = modes_split(s + 5, f, 8), t = -1, ok = n == 8;
+            for (int i = 0; ok && i < transport_count; i++) if (strcmp(transports[i].name, f[1]) == 0) t = i;
+            ok = ok && modes_number(f[0], 1, 6, &v[0]) && modes_number(f[3], 0, 1e6, &v[1]) && modes_number(f[4], 1e-9, 1e6, &v[2])
+                 && modes_number(f[5], 0, 1440, &v[3]) && modes_number(f[6], 0, 24, &v[4]) && modes_number(f[7], 0, 24, &v[5]);
+            if (!ok) err = "expected: mode PROBLEM | TRANSPORT | LABEL | BDT/KM | KM/H | HEADWAY MIN | FIRST HOUR | LAST HOUR";
+            else if (t < 0) err = "unknown transport";
+            else {
+                ProblemSpec *spec = &problems[(int)v[0] - 1];
+                int i = problem_mode_count(spec);
+                if (i == MAX_TRANSPORTS || strlen(f[2]) == 0 || strlen(f[2]) >= sizeof(spec->modes[0].name)) err = "too many modes or bad label";
+                else {
+                    ModeSpec *m = &spec->modes[i];
+                    strcpy(m->name, f[2]); m->transport = t;
+                    m->rate = v[1]; m->speed = v[2]; m->interval = v[3]; m->start_h = (int)v[4]; m->end_h = (int)v[5];
+                }
+            }
+        } else err = "expected a transport or mode line";
+    }
+    fclose(fp);
+    for (int p = 0; !err && p < 6; p++) if (!problem_mode_count(&problems[p])) err = "a problem has no modes";
+    if (err) { printf("Error: %s:%d: %s\n", path, line_no, err); return 0; }
+    modes_from_file = 1;
+    return 1;
+}
+
+// Adds modes to g in order and stages each one's CSV, leaving graph_build to the caller.
+// Returns 0, with a message, when a required CSV is missing.
+static inline int modes_read_csv(Graph *g, const ModeSpec *modes, int count) {
+    int ids[MAX_TRANSPORTS];
+    for (int i = 0; i < count; i++) {
+        const ModeSpec *m = &modes[i];
+        ids[i] = graph_add_mode(g, m->name, m->rate, m->speed, m->interval, m->start_h, m->end_h);
+    }
+    for (int i = 0; i < count; i++) {
+        const Transport *t = &transports[modes[i].transport];
+        int ok = t->two_way ? graph_load_roads(g, t->path, ids[i]) : graph_load_routes(g, t->path, ids[i]);
+        if (!ok && t->required) { printf("Error: %s not found!\n", t->path); return 0; }
+    }
+    return 1;
+}
+
+static inline int problem_load_data(Graph *g, const ProblemSpec *spec) {
+    if (!modes_read_csv(g, spec->modes, problem_mode_count(spec))) return 0;
+    graph_build(g);
+    return 1;
+}
+
+// Every transport once, named as in the transport table and with the fares and schedule of the
+// first problem that uses it, for the graph the server shares between problems.
+static inline int transports_read_csv(Graph *g) {
+    ModeSpec all[MAX_TRANSPORTS];
+    memset(all, 0, sizeof(all));
+    for (int t = 0; t < transport_count; t++) {
+        all[t].transport = t; all[t].speed = 1; all[t].end_h = 24;
+        for (int p = 5; p >= 0; p--)
+            for (int i = 0; i < problem_mode_count(&problems[p]); i++)
+                if (problems[p].modes[i].transport == t) all[t] = problems[p].modes[i];
+        strcpy(all[t].name, transports[t].name);
+    }
+    return modes_read_csv(g, all, transport_count);
+}
+
+// The files a snapshot of the given transports depends on; returns the count.
+static inline int transport_sources(const ModeSpec *modes, int count, const char **paths) {
+    for (int i = 0; i < count; i++) paths[i] = transports[modes ? modes[i].transport : i].path;
+    if (modes_from_file) paths[count++] = MODES_CONF;
+    return count;
+}
+
+// One contest program's state: its graph, index and search workspaces.
+typedef struct {
+    int id;                         // 1-6
+    const ProblemSpec *spec;
+    char name[16], snapshot[24];    // "problemN", its output prefix, and "problemN.graph"
+    const char *sources[MAX_TRANSPORTS + 1];
+    int source_count;
+    Graph graph;
+    KdTree index;
+    Timetable timetable;            // only for the time and deadline searches
+    ContractionHierarchy *hierarchy; // set by a front-end that loaded one
+    Landmarks *landmarks;           // set by problem_landmarks
+    Workspace ws;
+    RaptorWorkspace rw;
+    ParetoWorkspace pw;
+} Problem;
+
+// Exits when MODES_CONF is malformed.
+static inline void problem_init(Problem *p, int id) {
+    if (!modes_load(MODES_CONF)) exit(1);
+    STAT_RESET();
+    memset(p, 0, sizeof(*p));
+    p->id = id;
+    p->spec = &problems[id - 1];
+    snprintf(p->name, sizeof(p->name), "problem%d", id);
+    snprintf(p->snapshot, sizeof(p->snapshot), "problem%d.graph", id);
+    p->source_count = transport_sources(p->spec->modes, problem_mode_count(p->spec), p->sources);
+}
+
+// True when some mode of spec runs on a schedule.
+static inline int problem_has_schedule(const ProblemSpec *spec) {
+    for (int i = 0; i < problem_mode_count(spec); i++) if (spec->modes[i].interval > 0) return 1;
+    return 0;
+}
+
+// The Pareto search answers cost and distance problems with a deadline or a schedule.
+static inline int problem_pareto_search(const Problem *p) {
+    return p->spec->objective != OBJ_TIME && (p->spec->needs_deadline || problem_has_schedule(p->spec));
+}
+
+static inline int problem_scheduled_search(const Problem *p) {
+    return p->spec->objective == OBJ_TIME || problem_pareto_search(p);
+}
+
+// --compile: parses the CSVs and writes the snapshot. Returns the exit status.
+static inline int problem_compile(Problem *p) {
+    if (!problem_load_data(&p->graph, p->spec)) return 1;
+    if (!snapshot_save(&p->graph, p->snapshot, p->sources, p->source_count)) { printf("Error: cannot write %s\n", p->snapshot); return 1; }
+    printf("Compiled %s: %d nodes, %d edges\n", p->snapshot, p->graph.node_count, p->graph.edge_count);
+    return 0;
+}
+
+// Maps the compiled snapshot when it is current, otherwise parses the CSVs, then indexes the
+// nodes and, for the scheduled searches, cuts the scheduled modes into routes.
+static inline void problem_load(Problem *p) {
+    STAT_BEGIN(PHASE_LOAD);
+    if (!snapshot_load(&p->graph, p->snapshot, p->sources, p->source_count) && !problem_load_data(&p->graph, p->spec)) exit(1);
+    STAT_END(PHASE_LOAD);
+    STAT_BEGIN(PHASE_INDEX);
+    kd_build(&p->index, &p->graph, NULL);
+    workspace_init(&p->ws, p->graph.node_count);
+    if (problem_scheduled_search(p)) {
+        unsigned scheduled = 0;
+        for (int i = 0; i < p->graph.mode_count; i++) if (p->graph.modes[i].interval > 0) scheduled |= 1u << i;
+        timetable_build(&p->timetable, &p->graph, scheduled);
+        raptor_init(&p->rw, &p->timetable, p->graph.node_count);
+        if (problem_pareto_search(p)) pareto_init(&p->pw, p->graph.node_count);
+    }
+    STAT_END(PHASE_INDEX);
+}
+
+static inline void problem_free(Problem *p) {
+    workspace_free(&p->ws);
+    if (problem_scheduled_search(p)) {
+        raptor_free(&p->rw);
+        if (problem_pareto_search(p)) pareto_free(&p->pw);
+        timetable_free(&p->timetable);
+    }
+    kd_free(&p->index);
+    graph_free(&p->graph);
+}
+
+// Builds ALT tables into lm over the problem's own modes, for the objectives its search can
+// bound (cost and time for the Pareto search), and has problem_solve use them: cost and
+// distance searches then run A*. The caller frees lm after problem_free.
+static inline void problem_landmarks(Problem *p, Landmarks *lm, int count, LandmarkStrategy strategy) {
+    unsigned objectives = problem_pareto_search(p) ? (1u << OBJ_COST) | (1u << OBJ_TIME) : 1u << p->spec->objective;
+    landmarks_build(lm, &p->graph, p->graph.modes, ~0u, count, strategy, objectives);
+    p->landmarks = lm;
+}
+
+// Walks to the nearest node of each point at WALK_SPEED, leaves at start_time and searches on the
+// problem's objective, arriving by deadline (INF for none). On success fills pr with the legs
+// and the walks and returns 1; p->ws keeps the labels, ws.target the last node.
+static inline int problem_solve(Problem *p, double sLat, double sLon, double dLat, double dLon, double start_time, double deadline, PathResult *pr) {
+    const Graph *g = &p->graph;
+    double min_s, min_e;
+    STAT_BEGIN(PHASE_SNAP);
+    int start_node = kd_nearest(&p->index, ~0u, sLat, sLon, &min_s);
+    int end_node = kd_nearest(&p->index, ~0u, dLat, dLon, &min_e);
+    STAT_END(PHASE_SNAP);
+    if (start_node < 0) return 0;
+    double exit_walk = (min_e / WALK_SPEED) * 60.0;
+    Access exit = { end_node, exit_walk };
+    Query q = { start_node, end_node, start_time + (min_s / WALK_SPEED) * 60.0, INF, p->spec->objective, ~0u };
+    if (p->landmarks) { q.landmarks = p->landmarks; q.algorithm = ALG_ASTAR; }
+    int scheduled = problem_scheduled_search(p), found;
+    STAT_BEGIN(PHASE_SEARCH);
+    if (p->spec->objective == OBJ_TIME) found = raptor_search(g, g->modes, &p->timetable, &p->ws, &p->rw, &q);
+    else if (problem_pareto_search(p)) {
+        q.deadline = deadline; q.exits = &exit; q.exit_count = end_node >= 0;
+        found = pareto_search(g, g->modes, &p->timetable, &p->ws, &p->pw, &q) && pareto_pick(g, g->modes, &p->timetable, &p->ws, &p->pw, &q) >= 0;
+    } else if (p->hierarchy) found = ch_search(p->hierarchy, g, g->modes, &p->ws, &q);
+    else found = route_search(g, g->modes, &p->ws, &q);
+    STAT_END(PHASE_SEARCH);
+    if (!found) return 0;
+    // Scheduled searches only wait when boarding, so each ride departs its ride time before its arrival
+    STAT_BEGIN(PHASE_OUTPUT);
+    path_build(pr, g, g->modes, &p->ws, p->ws.target, scheduled);
+    path_set_ends(pr, sLat, sLon, dLat, dLon, start_time, exit_walk);
+    STAT_END(PHASE_OUTPUT);
+    return 1;
+}
+
+// Prints what the run has counted since problem_init as one JSON line on stderr; nothing
+// unless built with ROUTE_STATS.
+static inline void problem_stats(const Problem *p) {
+    stats_print(stderr, p->name, &stats_thread);
+}
+
+#endif
@@ -0,0 +1,402 @@
+#ifndef ROUTE_H
+#define ROUTE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "graph.h"
+#include "pq.h"
+#include "landmarks.h"
+
+// Shortest-path engine shared by the problem front-ends and the query server.
+// A query runs against a built Graph with a mode table (fares, speeds, schedules) supplied by
+// the caller, so one loaded graph can answer every problem's variant. All per-query state lives
+// in a Workspace that is reused from one query to the next; a workspace belongs to one thread.
+
+#ifndef INF
+#define INF 1e15
+#endif
+
+#define WALK_SPEED 2.0 // km/h, used to reach the first node and leave the last one
+
+typedef enum { OBJ_DISTANCE, OBJ_COST, OBJ_TIME } Objective;
+
+// What each objective scores, in one place so a new objective is a new case in each function
+// below rather than a change to every search.
+// Label of a node first reached at time t (a source).
+static inline double objective_start(Objective o, double t) {
+    return o == OBJ_TIME ? t : 0;
+}
+
+// Label after riding d km of mode m from a node labelled key, arriving at arrival.
+static inline double objective_relax(Objective o, double key, double d, const Mode *m, double arrival) {
+    switch (o) {
+    case OBJ_DISTANCE: return key + d;
+    case OBJ_COST: return key + d * m->cost_rate;
+    default: return arrival;
+    }
+}
+
+// What the walk from the last node to the destination adds.
+static inline double objective_exit(Objective o, double walk_min) {
+    return o == OBJ_TIME ? walk_min : 0;
+}
+
+// The objective's value of a route with these totals.
+static inline double objective_total(Objective o, double time, double cost, double dist) {
+    return o == OBJ_TIME ? time : o == OBJ_COST ? cost : dist;
+}
+
+// Least the objective can grow per straight-line km on mode m, for the A* bound.
+static inline double objective_rate(Objective o, const Mode *m) {
+    switch (o) {
+    case OBJ_DISTANCE: return 1.0;
+    case OBJ_COST: return m->cost_rate;
+    default: return 60.0 / m->speed;
+    }
+}
+
+// ALG_ASTAR steers the search with a straight-line lower bound on the remaining objective, or
+// the landmark bound when the query carries landmark tables and that is higher;
+// ALG_BIDIRECTIONAL grows a second search back from the destination and needs
+// graph_build_reverse. Bidirectional search only applies to distance queries on unscheduled
+// modes without a deadline, since the backward half cannot know clock times; other queries
+// fall back to A*.
+typedef enum { ALG_DIJKSTRA, ALG_ASTAR, ALG_BIDIRECTIONAL } Algorithm;
+
+// A node reachable on foot from a query point.
+typedef struct {
+    int node;
+    double walk_min;
+} Access;
+
+typedef struct {
+    int src, dst;
+    double start_time;      // minutes after midnight when leaving src
+    double deadline;        // latest arrival at any node, INF for none
+    Objective objective;
+    unsigned mode_mask;     // bit i set when modes[i] may be used
+    // Optional candidate entry/exit nodes that replace src/dst when their counts are non-zero.
+    // Entries are boarded at start_time + walk_min (start_time is then the departure from the
+    // query point); for time searches an exit's walk is added to its arrival.
+    // With dst -1 and no exits the search labels every node it can reach (one-to-all).
+    const Access *entries, *exits;
+    int entry_count, exit_count;
+    Algorithm algorithm;
+    const Landmarks *landmarks; // optional; covering mask with fares and speeds no better than modes
+} Query;
+
+// Per-node arrays are generation stamped: a node's key/time/cost/dist/prev are only valid when
+// seen[v] == gen, so starting a query bumps gen instead of rewriting O(V) entries.
+typedef struct {
+    int n;
+    double *key;            // objective value
+    double *time_at, *cost_at, *dist_at;
+    int *prev;
+    int *prev_edge;         // edge from prev[v] to v, -1 at a source
+    unsigned *seen, *done;  // generation in which the node was reached / settled
+    unsigned gen;
+    int target;             // node the last search finished at, -1 if none
+    long settled;           // nodes settled by the last search, both directions counted
+    IndexedHeap heap;
+    RadixHeap radix;
+    // Backward half of bidirectional searches: distance to the destination and the edge (or
+    // hierarchy arc) towards it.
+    double *bkey;
+    int *bnext;
+    unsigned *bseen, *bdone;
+    IndexedHeap bheap;
+} Workspace;
+
+static inline void workspace_init(Workspace *ws, int n) {
+    ws->n = n;
+    ws->key = (double *)malloc(n * sizeof(double));
+    ws->time_at = (double *)malloc(n * sizeof(double));
+    ws->cost_at = (double *)malloc(n * sizeof(double));
+    ws->dist_at = (double *)malloc(n * sizeof(double));
+    ws->prev = (int *)malloc(n * sizeof(int));
+    ws->prev_edge = (int *)malloc(n * sizeof(int));
+    ws->seen = (unsigned *)calloc(n ? n : 1, sizeof(unsigned));
+    ws->done = (unsigned *)calloc(n ? n : 1, sizeof(unsigned));
+    ws->gen = 0;
+    heap_init(&ws->heap, n);
+    radix_init(&ws->radix);
+    ws->bkey = (double *)malloc(n * sizeof(double));
+    ws->bnext = (int *)malloc(n * sizeof(int));
+    ws->bseen = (unsigned *)calloc(n ? n : 1, sizeof(unsigned));
+    ws->bdone = (unsigned *)calloc(n ? n : 1, sizeof(unsigned));
+    heap_init(&ws->bheap, n);
+}
+
+static inline void workspace_free(Workspace *ws) {
+    free(ws->key); free(ws->time_at); free(ws->cost_at); free(ws->dist_at); free(ws->prev); free(ws->prev_edge);
+    free(ws->seen); free(ws->done);
+    heap_free(&ws->heap);
+    radix_free(&ws->radix);
+    free(ws->bkey); free(ws->bnext); free(ws->bseen); free(ws->bdone);
+    heap_free(&ws->bheap);
+}
+
+// Starts a new query generation; stamps are only rewritten when the counter wraps.
+static inline void workspace_next(Workspace *ws) {
+    if (++ws->gen == 0) {
+        memset(ws->seen, 0, ws->n * sizeof(unsigned));
+        memset(ws->done, 0, ws->n * sizeof(unsigned));
+        memset(ws->bseen, 0, ws->n * sizeof(unsigned));
+        memset(ws->bdone, 0, ws->n * sizeof(unsigned));
+        ws->gen = 1;
+    }
+}
+
+// Objective value of v in the current query, INF if it was not reached.
+static inline double workspace_key(const Workspace *ws, int v) {
+    return ws->seen[v] == ws->gen ? ws->key[v] : INF;
+}
+
+// Minutes until the next departure of m at time t; INF outside service hours.
+static inline double mode_wait(const Mode *m, double t) {
+    STAT_ADD(STAT_WAITS, 1);
+    if (m->interval == 0) return 0; // Car
+    if (t < m->start_h * 60) return (m->start_h * 60) - t;
+    if (t > m->end_h * 60) return INF;
+    return fmod(m->interval - fmod(t, m->interval), m->interval);
+}
+
+// Nearest node to (lat, lon) whose incident modes intersect mask; node_modes may be NULL to
+// accept every node. Returns -1 for an empty graph.
+static inline int route_nearest(const Graph *g, const unsigned *node_modes, unsigned mask, double lat, double lon, double *dist_km) {
+    int best = -1; double best_d = INF;
+    for (int i = 0; i < g->node_count; i++) {
+        if (node_modes && !(node_modes[i] & mask)) continue;
+        double d = haversine(lat, lon, g->nodes[i].lat, g->nodes[i].lon);
+        if (d < best_d) { best_d = d; best = i; }
+    }
+    if (dist_km) *dist_km = best_d;
+    return best;
+}
+
+// Converts straight-line km into a lower bound on the objective: every usable mode covers at
+// least that distance, at no more than the fastest speed and no less than the cheapest fare.
+static inline double route_bound_scale(const Mode *modes, int mode_count, const Query *q) {
+    if (q->objective == OBJ_DISTANCE) return 1.0;
+    double scale = INF;
+    for (int i = 0; i < mode_count; i++) {
+        if (!(q->mode_mask & (1u << i))) continue;
+        double s = objective_rate(q->objective, &modes[i]);
+        if (s < scale) scale = s;
+    }
+    return scale < INF ? scale : 0;
+}
+
+// Higher of the straight-line and landmark bounds from v to node t.
+static inline double route_bound_to(const Graph *g, const Query *q, double scale, int v, int t) {
+    const Coord *a = &g->nodes[v], *b = &g->nodes[t];
+    double h = scale * haversine(a->lat, a->lon, b->lat, b->lon);
+    if (q->landmarks) { double l = landmarks_bound(q->landmarks, q->objective, v, t); if (l > h) h = l; }
+    return h;
+}
+
+// A* lower bound from v to the nearest destination; for time queries it includes the exit walk.
+static inline double route_bound(const Graph *g, const Query *q, double scale, int v) {
+    if (!q->exit_count && q->dst < 0) return 0;
+    if (!q->exit_count) return route_bound_to(g, q, scale, v, q->dst);
+    double best = INF;
+    for (int i = 0; i < q->exit_count; i++) {
+        double h = route_bound_to(g, q, scale, v, q->exits[i].node) + objective_exit(q->objective, q->exits[i].walk_min);
+        if (h < best) best = h;
+    }
+    return best;
+}
+
+static inline int route_search_bidirectional(const Graph *g, const Mode *modes, Workspace *ws, const Query *q);
+
+// For searches that assemble the path themselves: given prev and prev_edge from ws->target back
+// to a source (whose time_at is set), fills key (as distance), dist_at, cost_at and time_at
+// along it in path order, so the sums match a forward distance search over the same path.
+static inline void route_fill_path(const Graph *g, const Mode *modes, Workspace *ws) {
+    int first = ws->target;
+    for (int v = ws->target, next = -1; ; next = v, v = ws->prev[v]) {
+        ws->bnext[v] = next;    // forward successor, only needed for the fill below
+        ws->seen[v] = ws->gen;
+        first = v;
+        if (ws->prev[v] == -1) break;
+    }
+    ws->key[first] = 0; ws->cost_at[first] = 0; ws->dist_at[first] = 0;
+    for (int v = first; ws->bnext[v] != -1; v = ws->bnext[v]) {
+        int w = ws->bnext[v], e = ws->prev_edge[w];
+        const Mode *m = &modes[g->mode[e]];
+        ws->key[w] = ws->key[v] + g->dist[e];
+        ws->dist_at[w] = ws->dist_at[v] + g->dist[e];
+        ws->cost_at[w] = ws->cost_at[v] + g->dist[e] * m->cost_rate;
+        ws->time_at[w] = ws->time_at[v] + graph_ride_min(g, m, e);
+    }
+}
+
+// Dijkstra, or A* with q->algorithm, on q->objective. Plain Dijkstra on time uses the radix
+// heap since arrival times only grow; everything else uses the indexed heap keyed on the
+// objective plus the bound. time/cost/dist along the chosen tree are kept alongside the key.
+// With exits the search stops once no unsettled node can beat the best exit found so far.
+// Returns 1 when a destination was reached; ws->target names it.
+static inline int route_search(const Graph *g, const Mode *modes, Workspace *ws, const Query *q) {
+    if (q->algorithm == ALG_BIDIRECTIONAL) {
+        int ok = g->rev_off && q->objective == OBJ_DISTANCE && q->deadline >= INF;
+        for (int i = 0; ok && i < g->mode_count; i++) if ((q->mode_mask & (1u << i)) && modes[i].interval != 0) ok = 0;
+        if (ok) return route_search_bidirectional(g, modes, ws, q);
+    }
+    workspace_next(ws);
+    int astar = q->algorithm != ALG_DIJKSTRA;
+    int use_radix = q->objective == OBJ_TIME && !astar;
+    double scale = astar ? route_bound_scale(modes, g->mode_count, q) : 0;
+    int seeds = q->entry_count ? q->entry_count : 1;
+    for (int i = 0; i < seeds; i++) {
+        int s = q->entry_count ? q->entries[i].node : q->src;
+        double t = q->start_time + (q->entry_count ? q->entries[i].walk_min : 0);
+        double k = objective_start(q->objective, t);
+        if (k >= workspace_key(ws, s)) continue;
+        ws->seen[s] = ws->gen; ws->prev[s] = -1; ws->prev_edge[s] = -1;
+        ws->key[s] = k; ws->time_at[s] = t; ws->cost_at[s] = 0; ws->dist_at[s] = 0;
+        if (use_radix) radix_push(&ws->radix, k, s);
+        else heap_push(&ws->heap, s, k + (astar ? route_bound(g, q, scale, s) : 0));
+    }
+
+    double best = INF;
+    ws->target = -1; ws->settled = 0;
+    while (use_radix ? !radix_empty(&ws->radix) : !heap_empty(&ws->heap)) {
+        int u; double top;
+        if (use_radix) {
+            u = radix_pop(&ws->radix, &top);
+            if (ws->done[u] == ws->gen || top > ws->key[u]) continue;
+        } else { top = heap_top_key(&ws->heap); u = heap_pop(&ws->heap); }
+        ws->done[u] = ws->gen;
+        ws->settled++;
+        if (!q->exit_count) {
+            if (u == q->dst) { ws->target = u; break; }
+        } else {
+            if (top >= best) break;
+            for (int i = 0; i < q->exit_count; i++) {
+                if (q->exits[i].node != u) continue;
+                double total = ws->key[u] + objective_exit(q->objective, q->exits[i].walk_min);
+                if (total < best) { best = total; ws->target = u; }
+            }
+        }
+
+        STAT_ADD(STAT_RELAXED, g->off[u+1] - g->off[u]);
+        for (int e = g->off[u]; e < g->off[u+1]; e++) {
+            if (!(q->mode_mask & (1u << g->mode[e]))) continue;
+            const Mode *m = &modes[g->mode[e]]; int v = g->to[e]; double d = g->dist[e];
+            if (graph_factor(g, e) == 0) continue;
+            double wait = mode_wait(m, ws->time_at[u]);
+            if (wait == INF) continue;
+            double arrival = ws->time_at[u] + wait + graph_ride_min(g, m, e);
+            if (arrival > q->deadline) continue;
+            double k = objective_relax(q->objective, ws->key[u], d, m, arrival);
+            if (k < workspace_key(ws, v)) {
+                ws->key[v] = k; ws->prev[v] = u; ws->prev_edge[v] = e; ws->seen[v] = ws->gen;
+                ws->time_at[v] = arrival; ws->cost_at[v] = ws->cost_at[u] + d * m->cost_rate; ws->dist_at[v] = ws->dist_at[u] + d;
+                if (use_radix) radix_push(&ws->radix, k, v);
+                else heap_push(&ws->heap, v, k + (astar ? route_bound(g, q, scale, v) : 0));
+            }
+        }
+    }
+    heap_clear(&ws->heap);
+    radix_clear(&ws->radix);
+    return ws->target >= 0;
+}
+
+// Bidirectional Dijkstra on distance. The searches alternate by smaller queue head and stop once
+// the two heads together cannot beat the best meeting point; the backward half is then spliced
+// onto prev and time/cost/dist are filled in along the whole path, so callers see the same
+// Workspace fields as after a forward search.
+static inline int route_search_bidirectional(const Graph *g, const Mode *modes, Workspace *ws, const Query *q) {
+    workspace_next(ws);
+    unsigned gen = ws->gen;
+    int seeds = q->entry_count ? q->entry_count : 1, sinks = q->exit_count ? q->exit_count : 1;
+    for (int i = 0; i < seeds; i++) {
+        int s = q->entry_count ? q->entries[i].node : q->src;
+        if (ws->seen[s] == gen) continue;
+        ws->seen[s] = gen; ws->prev[s] = -1; ws->prev_edge[s] = -1; ws->key[s] = 0;
+        ws->time_at[s] = q->start_time + (q->entry_count ? q->entries[i].walk_min : 0);
+        heap_push(&ws->heap, s, 0);
+    }
+    for (int i = 0; i < sinks; i++) {
+        int t = q->exit_count ? q->exits[i].node : q->dst;
+        if (ws->bseen[t] == gen) continue;
+        ws->bseen[t] = gen; ws->bnext[t] = -1; ws->bkey[t] = 0;
+        heap_push(&ws->bheap, t, 0);
+    }
+
+    double mu = INF; int meet = -1;
+    ws->target = -1; ws->settled = 0;
+    while (!heap_empty(&ws->heap) && !heap_empty(&ws->bheap)) {
+        double ft = heap_top_key(&ws->heap), bt = heap_top_key(&ws->bheap);
+        if (ft + bt >= mu) break;
+        ws->settled++;
+        if (ft <= bt) {
+            int u = heap_pop(&ws->heap);
+            ws->done[u] = gen;
+            STAT_ADD(STAT_RELAXED, g->off[u+1] - g->off[u]);
+            for (int e = g->off[u]; e < g->off[u+1]; e++) {
+                if (!(q->mode_mask & (1u << g->mode[e])) || graph_factor(g, e) == 0) continue;
+                int v = g->to[e]; double k = ws->key[u] + g->dist[e];
+                if (k < workspace_key(ws, v)) {
+                    ws->key[v] = k; ws->prev[v] = u; ws->prev_edge[v] = e; ws->seen[v] = gen;
+                    heap_push(&ws->heap, v, k);
+                }
+                if (ws->bseen[v] == gen && ws->key[v] + ws->bkey[v] < mu) { mu = ws->key[v] + ws->bkey[v]; meet = v; }
+            }
+        } else {
+            int u = heap_pop(&ws->bheap);
+            ws->bdone[u] = gen;
+            STAT_ADD(STAT_RELAXED, g->rev_off[u+1] - g->rev_off[u]);
+            for (int r = g->rev_off[u]; r < g->rev_off[u+1]; r++) {
+                int e = g->rev_edge[r], v = g->rev_from[r];
+                if (!(q->mode_mask & (1u << g->mode[e])) || graph_factor(g, e) == 0) continue;
+                double k = ws->bkey[u] + g->dist[e];
+                if (ws->bseen[v] != gen || k < ws->bkey[v]) {
+                    ws->bkey[v] = k; ws->bnext[v] = e; ws->bseen[v] = gen;
+                    heap_push(&ws->bheap, v, k);
+                }
+                if (ws->seen[v] == gen && ws->key[v] + ws->bkey[v] < mu) { mu = ws->key[v] + ws->bkey[v]; meet = v; }
+            }
+        }
+    }
+    // A source that is also a destination meets without any edge being relaxed.
+    for (int i = 0; i < seeds; i++) {
+        int s = q->entry_count ? q->entries[i].node : q->src;
+        if (ws->bseen[s] == gen && ws->bkey[s] < mu) { mu = ws->bkey[s]; meet = s; }
+    }
+    heap_clear(&ws->heap);
+    heap_clear(&ws->bheap);
+    if (meet < 0) return 0;
+
+    // Splice the backward half onto prev, then walk the path forward filling in the totals.
+    int u = meet;
+    while (ws->bnext[u] != -1) {
+        int e = ws->bnext[u], v = g->to[e];
+        ws->prev[v] = u; ws->prev_edge[v] = e; ws->seen[v] = gen;
+        u = v;
+    }
+    ws->target = u;
+    route_fill_path(g, modes, ws);
+    return 1;
+}
+
+// Writes the node sequence src..dst into path (room for ws->n ints); returns its length.
+static inline int route_path(const Workspace *ws, int dst, int *path) {
+    int count = 0;
+    for (int v = dst; v != -1; v = ws->prev[v]) count++;
+    int i = count;
+    for (int v = dst; v != -1; v = ws->prev[v]) path[--i] = v;
+    return count;
+}
+
+static inline void format_time(double mins, char *buf) {
+    int h = ((int)(mins / 60)) % 24;
+    int m = (int)fmod(mins, 60);
+    char *period = (h >= 12) ? "PM" : "AM";
+    int h12 = (h % 12 == 0) ? 12 : h % 12;
+    sprintf(buf, "%02d:%02d %s", h12, m, period);
+}
+
+#endif
@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "service.h"
+
+// Resident routing server: loads the full road + transit graph once and answers problem 1-6
+// queries against it, one request per line (protocol in service.h).
+//   server [--compile] [--simplify] [--candidates K] [--algorithm NAME] [--landmarks K] [--landmark-select avoid|farthest] [--cache MB] [--cache-bucket MIN] [--updates FILE] [--socket PATH]
+// Requests come from stdin unless --socket is given, in which case any number of clients may
+// connect to the Unix socket at PATH. --simplify serves (and --compile writes) the simplified
+// graph, whose replies still carry every shape point of the path. --landmarks K builds the ALT
+// tables of service.h from K landmarks, chosen by --landmark-select (avoid by default).
+// --cache MB keeps up to MB megabytes of earlier results (service.h), keyed on the nearest entry
+// and exit nodes, so it is turned off when --candidates is above 1; on timetable problems a
+// repeat only hits when it leaves at the same moment, unless --cache-bucket MIN widens that to
+// MIN-minute buckets; within a bucket a hit is only used while its route is still optimal.
+// "cache" reports the hit rate and every update empties the cache.
+// Update requests (service.h) edit the road network between queries; --updates replays a file
+// of them at startup, so graph version N is the loaded graph plus the file's first N updates.
+// Built with ROUTE_STATS, the server logs the load and every query as a JSON stats line on
+// stderr, and answers "stats" with the totals.
+
+#define MAX_CLIENTS 64
+#define REQUEST_MAX 512
+
+Service service;
+Session session;
+
+int write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n <= 0) return 0;
+        buf += n; len -= n;
+    }
+    return 1;
+}
+
+// Answers a query or applies an update.
+void serve_line(const char *line, Reply *r) {
+    if (service_is_update(line)) service_update(&service, &session, line, r);
+    else if (service_answer(&service, &session, line, r)) stats_print(stderr, "query", &stats_thread);
+}
+
+// Applies every update in path, reporting the ones that fail. Returns 0 if path cannot be read.
+int apply_updates(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return 0;
+    char line[REQUEST_MAX];
+    Reply r = {0};
+    int line_no = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        line_no++;
+        char *s = line + strspn(line, " \t\r\n");
+        if (*s == '\0' || *s == '#') continue;
+        r.len = 0;
+        if (!service_is_update(s)) out_printf(&r, "ERR not an update\n");
+        else service_update(&service, &session, s, &r);
+        if (r.len && r.buf[0] == 'E') fprintf(stderr, "Warning: %s:%d: %.*s", path, line_no, (int)r.len, r.buf);
+    }
+    fclose(fp);
+    free(r.buf);
+    fprintf(stderr, "Applied %s: graph version %u\n", path, service.graph.version);
+    return 1;
+}
+
+void serve_stdin() {
+    char line[REQUEST_MAX];
+    Reply r = {0};
+    while (fgets(line, sizeof(line), stdin)) {
+        if (line[strspn(line, " \t\r\n")] == '\0') continue;
+        r.len = 0;
+        serve_line(line, &r);
+        fwrite(r.buf, 1, r.len, stdout);
+        fflush(stdout);
+    }
+    free(r.buf);
+}
+
+typedef struct {
+    char buf[REQUEST_MAX];
+    int len;
+} Client;
+
+// Single-threaded poll loop; a client's partial line is kept until its newline arrives.
+int serve_socket(const char *sock_path) {
+    int ls = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, sock_path, sizeof(addr.sun_path) - 1);
+    unlink(sock_path);
+    if (ls < 0 || bind(ls, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(ls, 16) != 0) {
+        fprintf(stderr, "Error: cannot listen on %s\n", sock_path);
+        return 1;
+    }
+    fprintf(stderr, "Listening on %s\n", sock_path);
+
+    struct pollfd fds[MAX_CLIENTS + 1];
+    static Client clients[MAX_CLIENTS + 1];
+    Reply r = {0};
+    int nfds = 1;
+    fds[0].fd = ls; fds[0].events = POLLIN;
+    for (;;) {
+        if (poll(fds, nfds, -1) < 0) continue;
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(ls, NULL, NULL);
+            if (fd >= 0 && nfds <= MAX_CLIENTS) {
+                fds[nfds].fd = fd; fds[nfds].events = POLLIN; fds[nfds].revents = 0;
+                clients[nfds].len = 0;
+                nfds++;
+            } else if (fd >= 0) close(fd);
+        }
+        for (int i = 1; i < nfds; i++) {
+            if (!fds[i].revents) continue;
+            Client *c = &clients[i];
+            ssize_t n = read(fds[i].fd, c->buf + c->len, sizeof(c->buf) - 1 - c->len);
+            int ok = n > 0;
+            if (ok) {
+                c->len += n;
+                int start = 0;
+                for (int j = 0; j < c->len; j++) {
+                    if (c->buf[j] != '\n') continue;
+                    c->buf[j] = '\0';
+                    r.len = 0;
+                    if (c->buf[start + strspn(c->buf + start, " \t\r")] != '\0') {
+                        serve_line(c->buf + start, &r);
+                        ok = write_all(fds[i].fd, r.buf, r.len);
+                    }
+                    start = j + 1;
+                }
+                memmove(c->buf, c->buf + start, c->len - start);
+                c->len -= start;
+                if (c->len == (int)sizeof(c->buf) - 1) {
+                    const char *msg = "ERR request too long\n";
+                    ok = ok && write_all(fds[i].fd, msg, strlen(msg));
+                    c->len = 0;
+                }
+            }
+            if (!ok) {
+                close(fds[i].fd);
+                nfds--;
+                fds[i] = fds[nfds]; clients[i] = clients[nfds];
+                i--;
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *sock_path = NULL, *updates_path = NULL;
+    int compile = 0, simplify = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--compile") == 0) compile = 1;
+        else if (strcmp(argv[i], "--simplify") == 0) simplify = 1;
+        else if (strcmp(argv[i], "--candidates") == 0 && i + 1 < argc) service.candidates = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--algorithm") == 0 && i + 1 < argc && service_algorithm(argv[i + 1]) >= 0) service.algorithm = (Algorithm)service_algorithm(argv[++i]);
+        else if (strcmp(argv[i], "--landmarks") == 0 && i + 1 < argc) service.landmark_count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--landmark-select") == 0 && i + 1 < argc && landmark_strategy(argv[i + 1]) >= 0) service.landmark_strategy = (LandmarkStrategy)landmark_strategy(argv[++i]);
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) service.cache_mb = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--cache-bucket") == 0 && i + 1 < argc) service.cache_bucket = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) sock_path = argv[++i];
+        else if (strcmp(argv[i], "--updates") == 0 && i + 1 < argc) updates_path = argv[++i];
+        else { fprintf(stderr, "Usage: %s [--compile] [--simplify] [--candidates K] [--algorithm NAME] [--landmarks K] [--landmark-select avoid|farthest] [--cache MB] [--cache-bucket MIN] [--updates FILE] [--socket PATH]\n", argv[0]); return 1; }
+    }
+    if (compile) {
+        // The snapshot is stamped with MODES_CONF and holds its transports, as service_load expects.
+        if (!modes_load(MODES_CONF)) return 1;
+        service_load_csv(&service.graph, simplify);
+        const char *sources[MAX_TRANSPORTS + 1];
+        if (!snapshot_save(&service.graph, SERVICE_SNAPSHOT, sources, transport_sources(NULL, transport_count, sources))) { printf("Error: cannot write %s\n", SERVICE_SNAPSHOT); return 1; }
+        printf("Compiled %s: %d nodes, %d edges\n", SERVICE_SNAPSHOT, service.graph.node_count, service.graph.edge_count);
+        return 0;
+    }
+    int mapped = service_load(&service.graph, simplify);
+    service_init(&service);
+    session_init(&session, &service);
+    fprintf(stderr, "Loaded %d nodes, %d edges from %s\n", service.graph.node_count, service.graph.edge_count, mapped ? SERVICE_SNAPSHOT : "the CSVs");
+    stats_print(stderr, "load", &stats_thread);
+    if (updates_path && !apply_updates(updates_path)) { fprintf(stderr, "Error: cannot read %s\n", updates_path); return 1; }
+    if (sock_path) return serve_socket(sock_path);
+    serve_stdin();
+    return 0;
+}
@@ -0,0 +1,448 @@
+#ifndef SERVICE_H
+#define SERVICE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "graph.h"
+#include "route.h"
+#include "snapshot.h"
+#include "kdtree.h"
+#include "transit.h"
+#include "pareto.h"
+#include "output.h"
+#include "problem.h"
+#include "update.h"
+#include "cache.h"
+
+// Request handling shared by the query server and the batch runner.
+// Both load the full road + transit graph once (every transport in problem.h, named as there); each
+// problem keeps its own fares, speeds and schedules from problem.h as a mode table and mask
+// applied at query time.
+// Request:  <problem 1-6> <src lat> <src lon> <dst lat> <dst lon> [HH MM [DH DM]] [dijkstra|astar|bidir]
+//           problems 4-6 need the start time, problem 6 also the deadline; a deadline given
+//           to any other problem is honoured too. The trailing word picks the search algorithm
+//           for this request, otherwise the service default is used.
+// Reply:    OK distance_km=.. cost_bdt=.. depart=HH:MM arrive=HH:MM nodes=N settled=N path=lon,lat;...
+//           ERR <message>
+// The request "stats" is answered with "OK " and the counters of every query so far as one
+// JSON line (out_stats), when built with ROUTE_STATS.
+// With cache_mb > 0 and a single candidate, replies come from a result cache (cache.h) when
+// the problem and the nearest entry and exit nodes match an earlier query on the same graph
+// version; such a reply has settled=0. When a timetable or deadline applies, the times of
+// leaving the entry node and of the deadline at the exit node (walks taken off) must fall in
+// the same buckets too: exact to a thousandth of a minute by default, or cache_bucket minutes
+// wide. Within a bucket a hit is only used when the stored route is still optimal: on a
+// timetable the query must leave no earlier than the stored trip and still in time for its
+// first vehicle, which fixes the arrival; otherwise the trip shifts with the departure. Neither
+// may have a looser deadline, and a hit that would miss this query's deadline is searched
+// afresh. The algorithm word is
+// not part of the key, as every algorithm finds an optimal route. The request "cache" is
+// answered with "OK hits=N misses=N hit_rate=F entries=N bytes=N".
+// Updates (service_update) edit the road network in place between queries, so every query runs
+// on one graph version; each accepted update bumps graph.version:
+//   close LAT1 LON1 LAT2 LON2    closes the road corridor between the two points, both ways
+//   slow F LAT1 LON1 LAT2 LON2   cars ride the corridor at F (0 < F <= 1) times their speed
+//   open LAT1 LON1 LAT2 LON2     undoes close and slow on the corridor
+//   add LAT1 LON1 LAT2 LON2      opens a new two-way road between the points
+// Points snap to the nearest road node. The corridor is the shortest road path between them on
+// the unedited network, so a closed corridor can be reopened by naming the same points.
+// Reply:    OK version=N edges=K
+// With candidates > 1 the search may start from, and end at, any of the that many nearest
+// usable nodes within SNAP_RADIUS_KM of each query point, instead of only the nearest one.
+// Fastest-route (time) requests are answered by raptor_search over the timetable, which pays
+// a wait only when boarding. Cost and distance requests with a deadline, or whose problem has a
+// scheduled mode, go to the Pareto search, which boards the same timetable and keeps every
+// (arrival, cost, transfers) trade-off, so it never misses a cheap route that is on time.
+// The algorithm word applies to the remaining requests.
+// With landmark_count > 0 the service keeps one set of ALT tables (landmarks.h) for every
+// problem, built with each mode at its lowest fare and highest speed in any problem so the
+// bounds hold for all of them: astar then uses them on distance and cost requests, and the
+// RAPTOR and Pareto searches always do. An added road segment rebuilds them.
+
+#define SNAP_RADIUS_KM 0.5        // 15 minutes on foot
+#define MAX_CANDIDATES 16
+#define SERVICE_SNAPSHOT "server.graph" // written by server --compile
+
+// Read-only after service_init, apart from service_update, so any number of threads may share
+// it as long as updates are applied between their queries.
+typedef struct {
+    Graph graph;
+    Mode profiles[6][MAX_MODES];
+    unsigned masks[6];
+    unsigned *node_modes;
+    KdTree index;
+    Timetable timetable;    // routes of every mode that runs on a schedule in some problem
+    unsigned road_mask;     // modes of the two-way transports, the ones updates edit
+    int candidates;         // entry/exit nodes considered per query point, 1 by default
+    Algorithm algorithm;    // used when a request does not name one
+    int landmark_count;     // ALT landmarks to build, 0 for none
+    LandmarkStrategy landmark_strategy;
+    Landmarks landmarks;
+    int cache_mb;           // result cache budget, 0 for none
+    int cache_bucket;       // minutes per cache time bucket, 0 (default) for exact times
+    Cache *cache;
+} Service;
+
+static const char *algorithm_names[] = {"dijkstra", "astar", "bidir"};
+
+// Returns the algorithm called name, or -1.
+static inline int service_algorithm(const char *name) {
+    for (int i = 0; i < 3; i++) if (strcmp(name, algorithm_names[i]) == 0) return i;
+    return -1;
+}
+
+// Per-thread query state.
+typedef struct {
+    Workspace ws;
+    RaptorWorkspace rw;
+    ParetoWorkspace pw;
+    int *path;
+    int *edges;     // edge into each path node
+} Session;
+
+typedef OutBuf Reply;
+
+// With simplify set, shape-only vertices are folded into their edges (graph_simplify): queries
+// then snap to intersections, stops and line ends only.
+static inline void service_load_csv(Graph *g, int simplify) {
+    if (!transports_read_csv(g)) exit(1);
+    if (simplify) {
+        int n = g->node_count, m = g->edge_count;
+        graph_simplify(g);
+        int points = 0;
+        for (int e = 0; e < g->edge_count; e++) {
+            const unsigned char *p = g->shape + g->shape_off[e], *end = g->shape + g->shape_off[e + 1];
+            for (; p < end; p++) points += !(*p & 0x80);
+        }
+        fprintf(stderr, "Simplified %d -> %d nodes, %d -> %d edges; %d shape points in %d bytes\n",
+                n, g->node_count, m, g->edge_count, points / 2, g->shape_bytes);
+    }
+    graph_build(g);
+}
+
+// Maps the compiled snapshot when it is current and matches simplify, otherwise parses the CSVs.
+// Returns 1 when the snapshot was used.
+static inline int service_load(Graph *g, int simplify) {
+    const char *sources[MAX_TRANSPORTS + 1];
+    if (!modes_load(MODES_CONF)) exit(1);
+    STAT_BEGIN(PHASE_LOAD);
+    if (snapshot_load(g, SERVICE_SNAPSHOT, sources, transport_sources(NULL, transport_count, sources))) {
+        if ((g->shape_off != NULL) == (simplify != 0)) { STAT_END(PHASE_LOAD); return 1; }
+        graph_free(g);
+    }
+    service_load_csv(g, simplify);
+    STAT_END(PHASE_LOAD);
+    return 0;
+}
+
+// (Re)builds the landmark tables shared by every problem.
+static inline void service_landmarks(Service *s) {
+    Mode loose[MAX_MODES];
+    unsigned mask = 0;
+    memcpy(loose, s->graph.modes, sizeof(loose));
+    for (int i = 0; i < s->graph.mode_count; i++) { loose[i].cost_rate = INF; loose[i].speed = 0; }
+    for (int p = 0; p < 6; p++)
+        for (int i = 0; i < s->graph.mode_count; i++) {
+            if (!(s->masks[p] & (1u << i))) continue;
+            if (s->profiles[p][i].cost_rate < loose[i].cost_rate) loose[i].cost_rate = s->profiles[p][i].cost_rate;
+            if (s->profiles[p][i].speed > loose[i].speed) loose[i].speed = s->profiles[p][i].speed;
+            mask |= 1u << i;
+        }
+    long t0 = stats_now_ns();
+    landmarks_free(&s->landmarks);
+    landmarks_build(&s->landmarks, &s->graph, loose, mask, s->landmark_count, s->landmark_strategy, 7u);
+    fprintf(stderr, "Landmarks: %d (%s) in %.2f s, %.1f MB\n", s->landmarks.count, landmark_strategy_names[s->landmark_strategy],
+            (stats_now_ns() - t0) * 1e-9, landmarks_bytes(&s->landmarks) / 1048576.0);
+}
+
+// Resolves each problem's mode list against the loaded graph into a mode table and mask.
+static inline void service_init(Service *s) {
+    STAT_BEGIN(PHASE_INDEX);
+    for (int p = 0; p < 6; p++) {
+        memcpy(s->profiles[p], s->graph.modes, sizeof(s->graph.modes));
+        s->masks[p] = 0;
+        for (int i = 0; i < problem_mode_count(&problems[p]); i++) {
+            const ModeSpec *spec = &problems[p].modes[i];
+            int id = graph_mode_id(&s->graph, transports[spec->transport].name);
+            if (id < 0) continue;
+            Mode *m = &s->profiles[p][id];
+            m->cost_rate = spec->rate; m->speed = spec->speed; m->interval = spec->interval;
+            m->start_h = spec->start_h; m->end_h = spec->end_h;
+            s->masks[p] |= 1u << id;
+        }
+    }
+    unsigned scheduled = 0;
+    for (int p = 0; p < 6; p++)
+        for (int i = 0; i < s->graph.mode_count; i++) if (s->profiles[p][i].interval > 0) scheduled |= 1u << i;
+    s->road_mask = 0;
+    for (int t = 0; t < transport_count; t++) {
+        int id = graph_mode_id(&s->graph, transports[t].name);
+        if (id >= 0 && transports[t].two_way && !(scheduled & (1u << id))) s->road_mask |= 1u << id;
+    }
+    timetable_build(&s->timetable, &s->graph, scheduled);
+    s->node_modes = graph_node_modes(&s->graph);
+    graph_build_reverse(&s->graph);
+    kd_build(&s->index, &s->graph, s->node_modes);
+    if (s->candidates < 1) s->candidates = 1;
+    if (s->candidates > MAX_CANDIDATES) s->candidates = MAX_CANDIDATES;
+    if (s->landmark_count > 0) service_landmarks(s);
+    if (s->cache_mb > 0 && s->candidates > 1) {
+        // The key holds one entry and exit node; routes from further candidates depend on them all.
+        fprintf(stderr, "Result cache off: it needs a single snap candidate\n");
+        s->cache_mb = 0;
+    }
+    if (s->cache_mb > 0) {
+        s->cache = (Cache *)malloc(sizeof(Cache));
+        cache_init(s->cache, (size_t)s->cache_mb << 20, s->cache_bucket);
+    }
+    STAT_END(PHASE_INDEX);
+}
+
+static inline void service_free(Service *s) {
+    kd_free(&s->index);
+    landmarks_free(&s->landmarks);
+    if (s->cache) { cache_free(s->cache); free(s->cache); s->cache = NULL; }
+    timetable_free(&s->timetable);
+    free(s->node_modes);
+    graph_free(&s->graph);
+}
+
+// Nodes usable under mask that a query point can walk to: the nearest ones within
+// SNAP_RADIUS_KM, or just the nearest node when none is that close. Returns the count.
+static inline int service_snap(const Service *s, unsigned mask, double lat, double lon, Access *out) {
+    int ids[MAX_CANDIDATES]; double dist[MAX_CANDIDATES];
+    int n = s->candidates > 1 ? kd_query(&s->index, mask, lat, lon, s->candidates, SNAP_RADIUS_KM, ids, dist) : 0;
+    if (n == 0) {
+        ids[0] = kd_nearest(&s->index, mask, lat, lon, &dist[0]);
+        n = ids[0] >= 0;
+    }
+    for (int i = 0; i < n; i++) { out[i].node = ids[i]; out[i].walk_min = (dist[i] / WALK_SPEED) * 60.0; }
+    return n;
+}
+
+static inline void session_init(Session *ss, const Service *s) {
+    workspace_init(&ss->ws, s->graph.node_count);
+    raptor_init(&ss->rw, &s->timetable, s->graph.node_count);
+    pareto_init(&ss->pw, s->graph.node_count);
+    ss->path = (int *)malloc((s->graph.node_count ? s->graph.node_count : 1) * sizeof(int));
+    ss->edges = (int *)malloc((s->graph.node_count ? s->graph.node_count : 1) * sizeof(int));
+}
+
+static inline void session_free(Session *ss) {
+    workspace_free(&ss->ws);
+    raptor_free(&ss->rw);
+    pareto_free(&ss->pw);
+    free(ss->path);
+    free(ss->edges);
+}
+
+// True when line is an update request rather than a query.
+static inline int service_is_update(const char *line) {
+    static const char *verbs[] = {"close", "slow", "open", "add"};
+    line += strspn(line, " \t");
+    for (int i = 0; i < 4; i++) {
+        size_t n = strlen(verbs[i]);
+        if (strncmp(line, verbs[i], n) == 0 && (line[n] == ' ' || line[n] == '\t')) return 1;
+    }
+    return 0;
+}
+
+// Applies one update request (see the protocol above), appending one reply line to r. ss is
+// only used to find the corridor. Returns 1 when the graph changed.
+static inline int service_update(Service *s, Session *ss, const char *line, Reply *r) {
+    Graph *g = &s->graph;
+    char verb[8];
+    double f = 1, p[4];
+    line += strspn(line, " \t");
+    sscanf(line, "%7s", verb);
+    int slow = strcmp(verb, "slow") == 0;
+    int ok = slow ? sscanf(line, "%*s %lf %lf %lf %lf %lf", &f, &p[0], &p[1], &p[2], &p[3]) == 5
+                  : sscanf(line, "%*s %lf %lf %lf %lf", &p[0], &p[1], &p[2], &p[3]) == 4;
+    if (!ok || (slow && !(f > 0 && f <= 1))) { out_printf(r, "ERR expected: %s %sLAT1 LON1 LAT2 LON2\n", verb, slow ? "F (0 < F <= 1) " : ""); return 0; }
+    if (strcmp(verb, "close") == 0) f = 0;
+    int a = kd_nearest(&s->index, s->road_mask, p[0], p[1], NULL), b = kd_nearest(&s->index, s->road_mask, p[2], p[3], NULL);
+    if (a < 0 || a == b) { out_printf(r, "ERR both points snap to the same road node\n"); return 0; }
+
+    int edges = 0;
+    if (strcmp(verb, "add") == 0) {
+        int from[2] = {a, b}, to[2] = {b, a};
+        double d = haversine(g->nodes[a].lat, g->nodes[a].lon, g->nodes[b].lat, g->nodes[b].lon), dist[2] = {d, d};
+        unsigned char mode[2];
+        mode[0] = mode[1] = (unsigned char)__builtin_ctz(s->road_mask);
+        int *remap = (int *)malloc((g->edge_count ? g->edge_count : 1) * sizeof(int));
+        graph_insert_edges(g, 2, from, to, dist, mode, remap);
+        timetable_remap(&s->timetable, remap);
+        free(remap);
+        if (s->landmarks.count) service_landmarks(s);
+        edges = 2;
+    } else {
+        Graph base = *g;
+        base.factor = NULL;
+        Query q = { a, b, 0, INF, OBJ_DISTANCE, s->road_mask };
+        Workspace *ws = &ss->ws;
+        if (!route_search(&base, g->modes, ws, &q)) { out_printf(r, "ERR no road between the points\n"); return 0; }
+        for (int v = b; ws->prev[v] != -1; v = ws->prev[v]) {
+            int u = ws->prev[v], e = ws->prev_edge[v];
+            graph_set_factor(g, e, f); edges++;
+            for (int k = g->off[v]; k < g->off[v+1]; k++)
+                if (g->to[k] == u && g->mode[k] == g->mode[e]) { graph_set_factor(g, k, f); edges++; break; }
+        }
+    }
+    g->version++;
+    out_printf(r, "OK version=%u edges=%d\n", g->version, edges);
+    return 1;
+}
+
+// Appends the cache's hit and miss counts and size as key=value pairs.
+static inline void service_cache_report(Cache *c, Reply *r, const char *prefix, const char *suffix) {
+    pthread_mutex_lock(&c->lock);
+    long total = c->hits + c->misses;
+    out_printf(r, "%shits=%ld misses=%ld hit_rate=%.3f entries=%d bytes=%zu%s", prefix, c->hits, c->misses,
+               total ? (double)c->hits / total : 0.0, c->count, c->bytes, suffix);
+    pthread_mutex_unlock(&c->lock);
+}
+
+// Minutes on foot between a query point and node, one of its count access nodes.
+static inline double service_walk(const Access *a, int count, int node) {
+    int i = 0;
+    while (i < count - 1 && a[i].node != node) i++;
+    return a[i].walk_min;
+}
+
+// Counters of every query answered so far, across threads.
+static QueryStats service_stats;
+
+static inline void service_reply(const Service *s, Session *ss, const char *line, Reply *r) {
+    int p, sh, sm, dh, dm;
+    double sLat, sLon, dLat, dLon;
+    int n = sscanf(line, "%d %lf %lf %lf %lf %d %d %d %d", &p, &sLat, &sLon, &dLat, &dLon, &sh, &sm, &dh, &dm);
+    if (n < 5) { out_printf(r, "ERR expected: problem slat slon dlat dlon [HH MM [DH DM]] [algorithm]\n"); return; }
+    Algorithm algorithm = s->algorithm;
+    const char *word = line + strlen(line);
+    while (word > line && (word[-1] == '\n' || word[-1] == '\r' || word[-1] == ' ')) word--;
+    const char *end = word;
+    while (word > line && word[-1] >= 'a' && word[-1] <= 'z') word--;
+    if (word < end) {
+        char name[16];
+        int len = end - word < 15 ? (int)(end - word) : 15;
+        memcpy(name, word, len); name[len] = '\0';
+        int a = service_algorithm(name);
+        if (a < 0) { out_printf(r, "ERR unknown algorithm %s\n", name); return; }
+        algorithm = (Algorithm)a;
+    }
+    if (p < 1 || p > 6) { out_printf(r, "ERR unknown problem %d\n", p); return; }
+    const ProblemSpec *spec = &problems[p - 1];
+    if (spec->start_time < 0 && n < 7) { out_printf(r, "ERR problem %d needs a start time\n", p); return; }
+    if (spec->needs_deadline && n < 9) { out_printf(r, "ERR problem %d needs a deadline\n", p); return; }
+
+    const Graph *g = &s->graph;
+    double start_time = n >= 7 ? sh * 60.0 + sm : spec->start_time;
+    Access entries[MAX_CANDIDATES], exits[MAX_CANDIDATES];
+    STAT_BEGIN(PHASE_SNAP);
+    int entry_count = service_snap(s, s->masks[p - 1], sLat, sLon, entries);
+    int exit_count = service_snap(s, s->masks[p - 1], dLat, dLon, exits);
+    STAT_END(PHASE_SNAP);
+    if (!entry_count || !exit_count) { out_printf(r, "ERR graph is empty\n"); return; }
+
+    Workspace *ws = &ss->ws;
+    double deadline = n >= 9 ? dh * 60.0 + dm : INF;
+    int timed = spec->objective == OBJ_TIME || deadline < INF || problem_has_schedule(spec);
+    // The cache (single candidate only) works between the snapped nodes: this query leaves the
+    // entry node at leave and must reach the exit node by last.
+    double leave = start_time + entries[0].walk_min, last = deadline < INF ? deadline - exits[0].walk_min : INF;
+    CacheKey key;
+    CacheEntry hit;
+    int cached = 0;
+    if (s->cache) {
+        // A timetable makes the route depend on when the rider leaves the snapped node; without
+        // one the ride is the same at any hour.
+        key = cache_key(s->cache, p, entries[0].node, exits[0].node, timed ? leave : INF, last);
+        cached = cache_get(s->cache, g->version, &key, &hit, ss->path, ss->edges);
+    }
+    double dist_km, cost, arrive;
+    int count;
+    long settled = 0;
+    if (cached) {
+        const CacheTrip *t = &hit.trip;
+        dist_km = t->dist_km; cost = t->cost; count = hit.count;
+        double late = leave - t->depart;
+        if (problem_has_schedule(spec)) {
+            // Leaving up to slack later still boards the trip's first vehicle, and with it every
+            // later one; whatever that departure reaches the stored one could too, so the trip is
+            // still optimal as long as this query's deadline is no looser.
+            arrive = t->arrive;
+            cached = late >= -1e-9 && late <= t->slack + 1e-9 && last <= t->deadline + 1e-9;
+        } else {
+            // Rides take as long at any hour, so the trip shifts with the departure; it stays
+            // optimal unless this query leaves itself more time, which could admit a better one.
+            arrive = t->arrive + late;
+            cached = t->deadline >= INF || last - leave <= t->deadline - t->depart + 1e-9;
+        }
+        cached = cached && arrive <= last;
+    }
+    if (s->cache) cache_count(s->cache, cached);
+    if (!cached) {
+        Query q = { entries[0].node, exits[0].node, start_time, deadline, spec->objective,
+                    s->masks[p - 1], entries, exits, entry_count, exit_count, algorithm, s->landmarks.count ? &s->landmarks : NULL };
+        const Mode *modes = s->profiles[p - 1];
+        STAT_BEGIN(PHASE_SEARCH);
+        int found = spec->objective == OBJ_TIME ? raptor_search(g, modes, &s->timetable, ws, &ss->rw, &q)
+                  : q.deadline < INF || problem_has_schedule(spec) ? pareto_search(g, modes, &s->timetable, ws, &ss->pw, &q) && pareto_pick(g, modes, &s->timetable, ws, &ss->pw, &q) >= 0
+                  : route_search(g, modes, ws, &q);
+        STAT_END(PHASE_SEARCH);
+        if (!found) { out_printf(r, "ERR no route found\n"); return; }
+        int end_node = ws->target;
+        dist_km = ws->dist_at[end_node]; cost = ws->cost_at[end_node]; arrive = ws->time_at[end_node];
+        settled = ws->settled;
+        count = route_path(ws, end_node, ss->path);
+        for (int i = 0; i < count; i++) ss->edges[i] = i > 0 ? ws->prev_edge[ss->path[i]] : -1;
+        if (s->cache) {
+            CacheTrip t = { dist_km, cost, leave, arrive, last, 0 };
+            for (int i = 1; i < count; i++) {
+                const Mode *m = &modes[g->mode[ss->edges[i]]];
+                if (m->interval == 0) continue;
+                t.slack = ws->time_at[ss->path[i]] - graph_ride_min(g, m, ss->edges[i]) - ws->time_at[ss->path[i - 1]];
+                break;
+            }
+            cache_put(s->cache, g->version, &key, &t, ss->path, ss->edges, count);
+        }
+    }
+    STAT_BEGIN(PHASE_OUTPUT);
+
+    arrive += service_walk(exits, exit_count, ss->path[count - 1]);
+    out_printf(r, "OK distance_km=%.3f cost_bdt=%.2f depart=%02d:%02d arrive=%02d:%02d nodes=%d settled=%ld path=%f,%f",
+                 dist_km, cost, ((int)start_time / 60) % 24, (int)fmod(start_time, 60),
+                 ((int)arrive / 60) % 24, (int)fmod(arrive, 60), count, settled, sLon, sLat);
+    for (int i = 0; i < count; i++) {
+        if (i > 0) out_shape(r, g, ss->path[i - 1], ss->edges[i], ";", "");
+        out_bytes(r, ";", 1); out_coord(r, g->nodes[ss->path[i]].lon, g->nodes[ss->path[i]].lat, "");
+    }
+    out_bytes(r, ";", 1); out_coord(r, dLon, dLat, "\n");
+    STAT_END(PHASE_OUTPUT);
+}
+
+// Answers one request line, appending exactly one reply line to r. Returns 1 for a route
+// query, whose counters the calling thread's stats_thread then holds (and which are added to
+// service_stats), and 0 for "stats" and "cache".
+static inline int service_answer(const Service *s, Session *ss, const char *line, Reply *r) {
+    if (strncmp(line + strspn(line, " \t"), "stats", 5) == 0) {
+        if (!STATS_ENABLED) out_printf(r, "ERR built without ROUTE_STATS\n");
+        else { out_str(r, "OK "); out_stats(r, "total", &service_stats); }
+        return 0;
+    }
+    if (strncmp(line + strspn(line, " \t"), "cache", 5) == 0) {
+        if (!s->cache) out_printf(r, "ERR no result cache\n");
+        else service_cache_report(s->cache, r, "OK ", "\n");
+        return 0;
+    }
+    STAT_RESET();
+    STAT_ADD(STAT_BYTES, -(long)r->len);
+    service_reply(s, ss, line, r);
+    STAT_ADD(STAT_BYTES, (long)r->len);
+    if (STATS_ENABLED) stats_merge(&service_stats, &stats_thread);
+    return 1;
+}
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "graph.h"
+
+// Precompiled graph snapshots.
+// snapshot_save writes a built Graph (nodes, CSR arrays with precomputed distances, mode table)
+// to one file; snapshot_load maps it read-only and points the Graph straight into the mapping,
+// so startup does no parsing and no per-array allocation. A snapshot is rejected when its
+// magic, version, size or checksum is wrong, or when any source CSV's size or mtime differs
+// from the values recorded at compile time; callers then fall back to the CSV loaders.
+// The mode table is taken from the snapshot, so recompile after changing fares or speeds.
+// Shape bytes of a simplified graph are stored too; a snapshot without them loads with NULL
+// shape arrays.
+
+#define SNAPSHOT_MAGIC "RDGRAPH"
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_MAX_SOURCES 8
+
+typedef struct {
+    char path[64];
+    int64_t size, mtime;    // -1 when the file did not exist
+} SourceStamp;
+
+typedef struct {
+    char magic[8];
+    uint32_t version, source_count;
+    int32_t node_count, edge_count, mode_count, shape_bytes;
+    uint64_t file_size, checksum;   // checksum covers everything after the header
+    SourceStamp sources[SNAPSHOT_MAX_SOURCES];
+    uint64_t off_modes, off_nodes, off_off, off_to, off_dist, off_mode, off_shape_off, off_shape;   // shape offsets 0 when absent
+} SnapshotHeader;
+
+static inline void snapshot_stamp(SourceStamp *s, const char *path) {
+    struct stat st;
+    memset(s, 0, sizeof(*s));
+    strncpy(s->path, path, sizeof(s->path) - 1);
+    if (stat(path, &st) == 0) { s->size = st.st_size; s->mtime = st.st_mtime; }
+    else { s->size = -1; s->mtime = -1; }
+}
+
+static inline uint64_t snapshot_checksum(const unsigned char *p, size_t n) {
+    uint64_t h = 0xcbf29ce484222325ULL, w;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        memcpy(&w, p + i, 8);
+        h = (h ^ w) * 0x100000001b3ULL;
+        h ^= h >> 32;
+    }
+    for (; i < n; i++) h = (h ^ p[i]) * 0x100000001b3ULL;
+    return h;
+}
+
+static inline uint64_t snapshot_align(uint64_t x) { return (x + 7) & ~(uint64_t)7; }
+
+// Writes g to path. Returns 1 on success.
+static inline int snapshot_save(const Graph *g, const char *path, const char **sources, int source_count) {
+    if (source_count > SNAPSHOT_MAX_SOURCES) return 0;
+    SnapshotHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SNAPSHOT_MAGIC, 8);
+    h.version = SNAPSHOT_VERSION; h.source_count = source_count;
+    h.node_count = g->node_count; h.edge_count = g->edge_count; h.mode_count = g->mode_count;
+    for (int i = 0; i < source_count; i++) snapshot_stamp(&h.sources[i], sources[i]);
+
+    uint64_t at = snapshot_align(sizeof(h));
+    h.off_modes = at; at = snapshot_align(at + g->mode_count * sizeof(Mode));
+    h.off_nodes = at; at = snapshot_align(at + (uint64_t)g->node_count * sizeof(Coord));
+    h.off_off = at;   at = snapshot_align(at + (uint64_t)(g->node_count + 1) * sizeof(int));
+    h.off_to = at;    at = snapshot_align(at + (uint64_t)g->edge_count * sizeof(int));
+    h.off_dist = at;  at = snapshot_align(at + (uint64_t)g->edge_count * sizeof(double));
+    h.off_mode = at;  at = snapshot_align(at + (uint64_t)g->edge_count);
+    if (g->shape_off) {
+        h.shape_bytes = g->shape_bytes;
+        h.off_shape_off = at; at = snapshot_align(at + (uint64_t)(g->edge_count + 1) * sizeof(int));
+        h.off_shape = at;     at = snapshot_align(at + (uint64_t)g->shape_bytes);
+    }
+    h.file_size = at;
+
+    unsigned char *buf = (unsigned char *)calloc(1, at);
+    if (!buf) return 0;
+    memcpy(buf + h.off_modes, g->modes, g->mode_count * sizeof(Mode));
+    memcpy(buf + h.off_nodes, g->nodes, (size_t)g->node_count * sizeof(Coord));
+    memcpy(buf + h.off_off, g->off, (size_t)(g->node_count + 1) * sizeof(int));
+    memcpy(buf + h.off_to, g->to, (size_t)g->edge_count * sizeof(int));
+    memcpy(buf + h.off_dist, g->dist, (size_t)g->edge_count * sizeof(double));
+    memcpy(buf + h.off_mode, g->mode, (size_t)g->edge_count);
+    if (g->shape_off) {
+        memcpy(buf + h.off_shape_off, g->shape_off, (size_t)(g->edge_count + 1) * sizeof(int));
+        memcpy(buf + h.off_shape, g->shape, (size_t)g->shape_bytes);
+    }
+    uint64_t body = snapshot_align(sizeof(h));
+    h.checksum = snapshot_checksum(buf + body, at - body);
+    memcpy(buf, &h, sizeof(h));
+
+    FILE *fp = fopen(path, "wb");
+    int ok = fp && fwrite(buf, 1, at, fp) == at;
+    if (fp) ok = (fclose(fp) == 0) && ok;
+    free(buf);
+    if (!ok) remove(path);
+    return ok;
+}
+
+// Maps path into g if it is a valid, up-to-date snapshot of sources. Returns 1 on success;
+// on failure g is left untouched.
+static inline int snapshot_load(Graph *g, const char *path, const char **sources, int source_count) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SnapshotHeader)) { close(fd); return 0; }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return 0;
+
+    const SnapshotHeader *h = (const SnapshotHeader *)map;
+    int ok = memcmp(h->magic, SNAPSHOT_MAGIC, 8) == 0 && h->version == SNAPSHOT_VERSION
+          && h->file_size == (uint64_t)st.st_size && (int)h->source_count == source_count
+          && h->mode_count <= MAX_MODES;
+    for (int i = 0; ok && i < source_count; i++) {
+        SourceStamp cur;
+        snapshot_stamp(&cur, sources[i]);
+        ok = strcmp(cur.path, h->sources[i].path) == 0 && cur.size == h->sources[i].size && cur.mtime == h->sources[i].mtime;
+    }
+    uint64_t body = snapshot_align(sizeof(SnapshotHeader));
+    if (ok) ok = snapshot_checksum((const unsigned char *)map + body, h->file_size - body) == h->checksum;
+    if (!ok) { munmap(map, st.st_size); return 0; }
+
+    unsigned char *base = (unsigned char *)map;
+    memset(g, 0, sizeof(*g));
+    g->node_count = h->node_count; g->edge_count = h->edge_count; g->mode_count = h->mode_count;
+    memcpy(g->modes, base + h->off_modes, h->mode_count * sizeof(Mode));
+    g->nodes = (Coord *)(base + h->off_nodes);
+    g->off = (int *)(base + h->off_off);
+    g->to = (int *)(base + h->off_to);
+    g->dist = (double *)(base + h->off_dist);
+    g->mode = base + h->off_mode;
+    if (h->off_shape_off) {
+        g->shape_off = (int *)(base + h->off_shape_off);
+        g->shape = base + h->off_shape;
+        g->shape_bytes = h->shape_bytes;
+    }
+    g->map = map; g->map_size = st.st_size;
+    return 1;
+}
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <string.h>
+#include <time.h>
+
+// Query instrumentation, compiled in with -DROUTE_STATS (make STATS=1); without it every hook
+// below expands to nothing. Each thread counts into its own QueryStats, so the hot loops pay one
+// increment and no locking: heap pushes and pops, edges scanned by the relaxation loops, wait
+// computations, node id lookups while loading and bytes written, plus wall time per phase.
+// Callers reset it before a query, print it as one JSON line (out_stats) and fold it into a
+// shared total with stats_merge.
+
+typedef enum { PHASE_LOAD, PHASE_INDEX, PHASE_SNAP, PHASE_SEARCH, PHASE_OUTPUT, PHASE_COUNT } StatPhase;
+typedef enum { STAT_NODE_LOOKUPS, STAT_PUSHES, STAT_POPS, STAT_RELAXED, STAT_WAITS, STAT_BYTES, STAT_COUNT } StatCounter;
+
+static const char *stat_phase_names[PHASE_COUNT] = {"load", "index", "snap", "search", "output"};
+static const char *stat_counter_names[STAT_COUNT] = {"node_lookups", "pushes", "pops", "relaxed", "waits", "bytes"};
+
+typedef struct {
+    long queries;
+    long ns[PHASE_COUNT];
+    long count[STAT_COUNT];
+    long begin[PHASE_COUNT];    // start of the phase in progress
+} QueryStats;
+
+static inline long stats_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+#ifdef ROUTE_STATS
+#define STATS_ENABLED 1
+static __thread QueryStats stats_thread;
+#define STAT_ADD(c, n) (stats_thread.count[c] += (n))
+#define STAT_BEGIN(ph) (stats_thread.begin[ph] = stats_now_ns())
+#define STAT_END(ph) (stats_thread.ns[ph] += stats_now_ns() - stats_thread.begin[ph])
+#define STAT_RESET() (memset(&stats_thread, 0, sizeof(stats_thread)), stats_thread.queries = 1)
+#else
+#define STATS_ENABLED 0
+__attribute__((unused)) static __thread QueryStats stats_thread;
+#define STAT_ADD(c, n) ((void)0)
+#define STAT_BEGIN(ph) ((void)0)
+#define STAT_END(ph) ((void)0)
+#define STAT_RESET() ((void)0)
+#endif
+
+// Adds s into total; safe when several threads share total.
+static inline void stats_merge(QueryStats *total, const QueryStats *s) {
+    __atomic_fetch_add(&total->queries, s->queries, __ATOMIC_RELAXED);
+    for (int i = 0; i < PHASE_COUNT; i++) __atomic_fetch_add(&total->ns[i], s->ns[i], __ATOMIC_RELAXED);
+    for (int i = 0; i < STAT_COUNT; i++) __atomic_fetch_add(&total->count[i], s->count[i], __ATOMIC_RELAXED);
+}
+
+#endif
@@ -0,0 +1,378 @@
+#ifndef TRANSIT_H
+#define TRANSIT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "graph.h"
+#include "route.h"
+
+// Route/trip model of the scheduled modes and a round-based (RAPTOR) earliest-arrival search.
+// timetable_build cuts the edges of the scheduled modes into routes: chains of stops followed
+// in file order, with a new route wherever a line starts or branches off. Trips leave a route's
+// first stop every mode interval from start_h to end_h and reach each later stop after the ride
+// time at the mode speed, so a rider waits once when boarding and then stays on the vehicle.
+// The timetable only keeps kilometres; headways, service windows and speeds come from the mode
+// table passed with each query, so one timetable serves every problem's profile.
+// raptor_search runs in rounds. Round k scans every route through a node improved in round
+// k-1, boarding the earliest catchable trip, then relaxes the unscheduled edges (car) from the
+// nodes that improved with a Dijkstra pass; round k thus holds the journeys with k boardings,
+// and the search ends once a round improves nothing. Scheduled modes are only ridden through
+// their routes; their edges are never relaxed one by one.
+
+#define RAPTOR_MAX_ROUNDS 32
+
+typedef struct {
+    int mode;
+    int first, count;   // stop slots first..first+count-1
+} TransitRoute;
+
+typedef struct {
+    int route_count, slot_count;
+    TransitRoute *routes;
+    int *slot_node;     // node served at each stop slot
+    int *slot_route;
+    int *slot_edge;     // edge from the previous slot of the route, -1 at the first stop
+    double *slot_km;    // distance from the route's first stop
+    int *node_off, *node_slot;  // node_off[v]..node_off[v+1] index the slots serving v
+    int route_cap, slot_cap;
+} Timetable;
+
+static inline int timetable_add_slot(Timetable *tt, int node, int edge, double km) {
+    if (tt->slot_count == tt->slot_cap) {
+        tt->slot_cap = tt->slot_cap ? tt->slot_cap * 2 : 1024;
+        tt->slot_node = (int *)realloc(tt->slot_node, tt->slot_cap * sizeof(int));
+        tt->slot_route = (int *)realloc(tt->slot_route, tt->slot_cap * sizeof(int));
+        tt->slot_edge = (int *)realloc(tt->slot_edge, tt->slot_cap * sizeof(int));
+        tt->slot_km = (double *)realloc(tt->slot_km, tt->slot_cap * sizeof(double));
+    }
+    int s = tt->slot_count++;
+    tt->slot_node[s] = node; tt->slot_route[s] = tt->route_count - 1;
+    tt->slot_edge[s] = edge; tt->slot_km[s] = km;
+    tt->routes[tt->route_count - 1].count++;
+    return s;
+}
+
+// First edge of mode out of u that no route has taken yet, or -1.
+static inline int timetable_next_edge(const Graph *g, const unsigned char *used, int mode, int u) {
+    for (int e = g->off[u]; e < g->off[u+1]; e++) if (g->mode[e] == mode && !used[e]) return e;
+    return -1;
+}
+
+// Follows unused edges of mode from u, starting with edge e, as one new route. A route never
+// calls at a node twice: when the line comes back to one of its stops, the loop since that stop
+// is cut out and left for a route of its own. visit holds the number of the last route (1-based)
+// to call at each node.
+static inline void timetable_add_route(Timetable *tt, const Graph *g, unsigned char *used, int *visit, int mode, int u, int e) {
+    if (tt->route_count == tt->route_cap) {
+        tt->route_cap = tt->route_cap ? tt->route_cap * 2 : 64;
+        tt->routes = (TransitRoute *)realloc(tt->routes, tt->route_cap * sizeof(TransitRoute));
+    }
+    TransitRoute *r = &tt->routes[tt->route_count++];
+    r->mode = mode; r->first = tt->slot_count; r->count = 0;
+    double km = 0;
+    int *cut = NULL, cut_count = 0, cut_cap = 0;
+    timetable_add_slot(tt, u, -1, 0);
+    visit[u] = tt->route_count;
+    for (; e >= 0; e = timetable_next_edge(g, used, mode, g->to[e])) {
+        used[e] = 1;
+        int w = g->to[e];
+        if (visit[w] == tt->route_count && w == u) { used[e] = 0; break; }    // a pure loop ends where it began
+        if (visit[w] == tt->route_count) {
+            // The loop's edges stay taken until the route is done, so it is not ridden again.
+            int s = tt->slot_count - 1;
+            for (;; s--) {
+                if (cut_count + 1 >= cut_cap) { cut_cap = cut_cap ? cut_cap * 2 : 16; cut = (int *)realloc(cut, cut_cap * sizeof(int)); }
+                if (tt->slot_node[s] == w) break;
+                visit[tt->slot_node[s]] = 0;
+                cut[cut_count++] = tt->slot_edge[s];
+            }
+            cut[cut_count++] = e;
+            r->count -= tt->slot_count - 1 - s;
+            tt->slot_count = s + 1;
+            km = tt->slot_km[s];
+            continue;
+        }
+        visit[w] = tt->route_count;
+        km += g->dist[e];
+        timetable_add_slot(tt, w, e, km);
+    }
+    for (int i = 0; i < cut_count; i++) used[cut[i]] = 0;
+    free(cut);
+}
+
+// Builds the routes of every mode in mask from the graph's edges.
+static inline void timetable_build(Timetable *tt, const Graph *g, unsigned mask) {
+    int n = g->node_count, m = g->edge_count;
+    memset(tt, 0, sizeof(*tt));
+    unsigned char *used = (unsigned char *)calloc(m ? m : 1, 1);
+    int *indeg = (int *)malloc((n ? n : 1) * sizeof(int));
+    int *visit = (int *)calloc(n ? n : 1, sizeof(int));
+    for (int mode = 0; mode < g->mode_count; mode++) {
+        if (!(mask & (1u << mode))) continue;
+        memset(indeg, 0, n * sizeof(int));
+        for (int e = 0; e < m; e++) if (g->mode[e] == mode) indeg[g->to[e]]++;
+        // Lines start where nothing of theirs arrives; whatever is left are branches and loops.
+        for (int pass = 0; pass < 2; pass++)
+            for (int u = 0; u < n; u++) {
+                if (pass == 0 && indeg[u] != 0) continue;
+                int e;
+                while ((e = timetable_next_edge(g, used, mode, u)) >= 0) timetable_add_route(tt, g, used, visit, mode, u, e);
+            }
+    }
+    free(indeg); free(visit); free(used);
+
+    tt->node_off = (int *)calloc(n + 1, sizeof(int));
+    tt->node_slot = (int *)malloc((tt->slot_count ? tt->slot_count : 1) * sizeof(int));
+    for (int s = 0; s < tt->slot_count; s++) tt->node_off[tt->slot_node[s] + 1]++;
+    for (int v = 0; v < n; v++) tt->node_off[v + 1] += tt->node_off[v];
+    int *fill = (int *)malloc((n + 1) * sizeof(int));
+    memcpy(fill, tt->node_off, (n + 1) * sizeof(int));
+    for (int s = 0; s < tt->slot_count; s++) tt->node_slot[fill[tt->slot_node[s]]++] = s;
+    free(fill);
+}
+
+static inline void timetable_free(Timetable *tt) {
+    free(tt->routes); free(tt->slot_node); free(tt->slot_route); free(tt->slot_edge); free(tt->slot_km);
+    free(tt->node_off); free(tt->node_slot);
+    memset(tt, 0, sizeof(*tt));
+}
+
+// Minutes from a route's first stop to a stop km further along.
+static inline double timetable_offset(const Mode *m, double km) {
+    return (km / m->speed) * 60.0;
+}
+
+// Departure from the first stop of the earliest trip that passes offset minutes down the
+// route at or after t, or -1 when the service has ended.
+static inline double timetable_trip(const Mode *m, double offset, double t) {
+    STAT_ADD(STAT_WAITS, 1);
+    double first = m->start_h * 60.0;
+    double k = ceil((t - offset - first) / m->interval - 1e-9);
+    double dep = first + (k > 0 ? k : 0) * m->interval;
+    return dep <= m->end_h * 60.0 ? dep : -1;
+}
+
+// Per-thread RAPTOR state, used together with a Workspace.
+typedef struct {
+    int *board;         // per node: slot the ride that reached it was boarded at, -1 after an edge
+    int *via;           // per node: slot it was left at after a ride, else the edge that reached it
+    int *marked, marked_count;  // nodes improved since the last route scan
+    unsigned *mark, mark_gen;
+    int *route_from;    // per route: first slot to scan in this round, -1 when not queued
+    int *queue, queue_count;
+    int *path_node, *path_edge, path_cap;
+    double *path_time;
+} RaptorWorkspace;
+
+static inline void raptor_init(RaptorWorkspace *rw, const Timetable *tt, int n) {
+    memset(rw, 0, sizeof(*rw));
+    size_t cap = n > 0 ? n : 1, routes = tt->route_count > 0 ? tt->route_count : 1;
+    rw->board = (int *)malloc(cap * sizeof(int));
+    rw->via = (int *)malloc(cap * sizeof(int));
+    rw->marked = (int *)malloc(cap * sizeof(int));
+    rw->mark = (unsigned *)calloc(cap, sizeof(unsigned));
+    rw->route_from = (int *)malloc(routes * sizeof(int));
+    for (int r = 0; r < tt->route_count; r++) rw->route_from[r] = -1;
+    rw->queue = (int *)malloc(routes * sizeof(int));
+}
+
+static inline void raptor_free(RaptorWorkspace *rw) {
+    free(rw->board); free(rw->via); free(rw->marked); free(rw->mark); free(rw->route_from); free(rw->queue);
+    free(rw->path_node); free(rw->path_edge); free(rw->path_time);
+    memset(rw, 0, sizeof(*rw));
+}
+
+typedef struct {
+    const Graph *g;
+    const Mode *modes;
+    const Timetable *tt;
+    Workspace *ws;
+    RaptorWorkspace *rw;
+    const Query *q;
+    double best;        // best arrival at a destination so far, walk included
+    double scale;       // minutes per straight-line km at the fastest usable speed
+} Raptor;
+
+// Straight-line bound from v, computed once per query and kept in the backward-search slots.
+static inline double raptor_bound(Raptor *r, int v) {
+    Workspace *ws = r->ws;
+    if (ws->bseen[v] != ws->gen) { ws->bseen[v] = ws->gen; ws->bkey[v] = route_bound(r->g, r->q, r->scale, v); }
+    return ws->bkey[v];
+}
+
+static inline void raptor_mark(Raptor *r, int v) {
+    RaptorWorkspace *rw = r->rw;
+    if (rw->mark[v] == rw->mark_gen) return;
+    rw->mark[v] = rw->mark_gen;
+    rw->marked[rw->marked_count++] = v;
+}
+
+// Records arrival t at v (over a ride from slot board to slot via, or over edge via when board
+// is -1) when it beats v's label and, going by the straight-line bound, could still beat the
+// best destination so far.
+static inline int raptor_improve(Raptor *r, int v, double t, int prev, int board, int via) {
+    Workspace *ws = r->ws; const Query *q = r->q;
+    if (t > q->deadline || t >= workspace_key(ws, v)) return 0;
+    if (r->best < INF && t + raptor_bound(r, v) >= r->best) return 0;
+    ws->key[v] = t; ws->time_at[v] = t; ws->seen[v] = ws->gen; ws->prev[v] = prev;
+    r->rw->board[v] = board; r->rw->via[v] = via;
+    if (!q->exit_count) {
+        if (v == q->dst) { r->best = t; ws->target = v; }
+    } else {
+        for (int i = 0; i < q->exit_count; i++)
+            if (q->exits[i].node == v && t + q->exits[i].walk_min < r->best) { r->best = t + q->exits[i].walk_min; ws->target = v; }
+    }
+    raptor_mark(r, v);
+    return 1;
+}
+
+// A* over the unscheduled edges from every node marked so far. The straight-line bound is
+// consistent, so a node's label is final when it leaves the queue, and the pass stops once the
+// queue head cannot beat the best destination.
+static inline void raptor_relax_edges(Raptor *r) {
+    const Graph *g = r->g; Workspace *ws = r->ws; RaptorWorkspace *rw = r->rw;
+    for (int i = 0; i < rw->marked_count; i++) {
+        int v = rw->marked[i];
+        heap_push(&ws->heap, v, ws->key[v] + raptor_bound(r, v));
+    }
+    while (!heap_empty(&ws->heap)) {
+        if (heap_top_key(&ws->heap) >= r->best) break;
+        int u = heap_pop(&ws->heap);
+        ws->settled++;
+        STAT_ADD(STAT_RELAXED, g->off[u+1] - g->off[u]);
+        for (int e = g->off[u]; e < g->off[u+1]; e++) {
+            const Mode *m = &r->modes[g->mode[e]];
+            if (!(r->q->mode_mask & (1u << g->mode[e])) || m->interval != 0 || graph_factor(g, e) == 0) continue;
+            int v = g->to[e];
+            if (raptor_improve(r, v, ws->time_at[u] + graph_ride_min(g, m, e), u, -1, e)) heap_push(&ws->heap, v, ws->key[v] + raptor_bound(r, v));
+        }
+    }
+}
+
+// Rides route ri from slot from to its end, moving to an earlier trip wherever a node's label
+// allows one; ties board as late as possible so a journey never passes the same node twice.
+static inline void raptor_scan_route(Raptor *r, int ri, int from) {
+    const Timetable *tt = r->tt; Workspace *ws = r->ws;
+    const TransitRoute *route = &tt->routes[ri];
+    const Mode *m = &r->modes[route->mode];
+    double dep = -1; int board = -1;
+    STAT_ADD(STAT_RELAXED, route->first + route->count - from);
+    for (int s = from; s < route->first + route->count; s++) {
+        int v = tt->slot_node[s];
+        double offset = timetable_offset(m, tt->slot_km[s]);
+        ws->settled++;
+        if (board >= 0) raptor_improve(r, v, dep + offset, tt->slot_node[board], board, s);
+        if (ws->seen[v] == ws->gen) {
+            double d = timetable_trip(m, offset, ws->key[v]);
+            if (d >= 0 && (board < 0 || d <= dep)) { dep = d; board = s; }
+        }
+    }
+}
+
+// Rebuilds the journey to ws->target as a plain node path: prev and prev_edge link consecutive
+// nodes and key/time_at/cost_at/dist_at hold the running totals along it. Returns 0 if it cannot.
+static inline int raptor_fill_path(Raptor *r) {
+    const Graph *g = r->g; const Timetable *tt = r->tt; Workspace *ws = r->ws; RaptorWorkspace *rw = r->rw;
+    int count = 0, limit = ws->n + tt->slot_count;
+    for (int v = ws->target; ; ) {
+        if (count + tt->slot_count + 1 > rw->path_cap) {
+            rw->path_cap = (count + tt->slot_count + 1) * 2;
+            rw->path_node = (int *)realloc(rw->path_node, rw->path_cap * sizeof(int));
+            rw->path_edge = (int *)realloc(rw->path_edge, rw->path_cap * sizeof(int));
+            rw->path_time = (double *)realloc(rw->path_time, rw->path_cap * sizeof(double));
+        }
+        if (count > limit) return 0;
+        if (rw->board[v] >= 0) {
+            // Ride: every stop after the boarding one, back to front.
+            int b = rw->board[v], s = rw->via[v];
+            const Mode *m = &r->modes[tt->routes[tt->slot_route[s]].mode];
+            double dep = ws->time_at[v] - timetable_offset(m, tt->slot_km[s]);
+            for (; s > b; s--) {
+                rw->path_node[count] = tt->slot_node[s]; rw->path_edge[count] = tt->slot_edge[s];
+                rw->path_time[count++] = dep + timetable_offset(m, tt->slot_km[s]);
+            }
+            v = tt->slot_node[b];
+        } else if (ws->prev[v] >= 0) {
+            rw->path_node[count] = v; rw->path_edge[count] = rw->via[v]; rw->path_time[count++] = ws->time_at[v];
+            v = ws->prev[v];
+        } else {
+            rw->path_node[count] = v; rw->path_edge[count] = -1; rw->path_time[count++] = ws->time_at[v];
+            break;
+        }
+    }
+    int prev = -1;
+    for (int i = count - 1; i >= 0; i--) {
+        int v = rw->path_node[i], e = rw->path_edge[i];
+        ws->prev[v] = prev; ws->prev_edge[v] = e; ws->seen[v] = ws->gen;
+        ws->key[v] = ws->time_at[v] = rw->path_time[i];
+        ws->cost_at[v] = e < 0 ? 0 : ws->cost_at[prev] + g->dist[e] * r->modes[g->mode[e]].cost_rate;
+        ws->dist_at[v] = e < 0 ? 0 : ws->dist_at[prev] + g->dist[e];
+        prev = v;
+    }
+    return 1;
+}
+
+// Cost and distance of the journey raptor_search found to v, summed over its legs without
+// rewriting the labels, so any number of nodes can be read after a one-to-all search.
+static inline void raptor_totals(const Graph *g, const Mode *modes, const Timetable *tt, const Workspace *ws, const RaptorWorkspace *rw, int v, double *cost, double *dist) {
+    double c = 0, d = 0;
+    for (int steps = ws->n + tt->slot_count; steps > 0 && v >= 0; steps--) {
+        if (rw->board[v] >= 0) {
+            int b = rw->board[v], s = rw->via[v];
+            double km = tt->slot_km[s] - tt->slot_km[b];
+            c += km * modes[tt->routes[tt->slot_route[s]].mode].cost_rate; d += km;
+            v = tt->slot_node[b];
+        } else if (ws->prev[v] >= 0) {
+            int e = rw->via[v];
+            c += g->dist[e] * modes[g->mode[e]].cost_rate; d += g->dist[e];
+            v = ws->prev[v];
+        } else break;
+    }
+    *cost = c; *dist = d;
+}
+
+// Earliest arrival for q (objective must be OBJ_TIME) over the unscheduled edges and the
+// timetable's routes. Entries, exits and the deadline are honoured as in route_search, and
+// afterwards the Workspace looks as it does after a forward search along the chosen journey.
+static inline int raptor_search(const Graph *g, const Mode *modes, const Timetable *tt, Workspace *ws, RaptorWorkspace *rw, const Query *q) {
+    Raptor r = { g, modes, tt, ws, rw, q, INF, route_bound_scale(modes, g->mode_count, q) };
+    workspace_next(ws);
+    if (++rw->mark_gen == 0) { memset(rw->mark, 0, ws->n * sizeof(unsigned)); rw->mark_gen = 1; }
+    rw->marked_count = 0;
+    ws->target = -1; ws->settled = 0;
+    int seeds = q->entry_count ? q->entry_count : 1;
+    for (int i = 0; i < seeds; i++) {
+        int s = q->entry_count ? q->entries[i].node : q->src;
+        raptor_improve(&r, s, q->start_time + (q->entry_count ? q->entries[i].walk_min : 0), -1, -1, -1);
+    }
+    raptor_relax_edges(&r);
+
+    for (int round = 0; round < RAPTOR_MAX_ROUNDS && rw->marked_count > 0; round++) {
+        // Queue each route through a marked node from its earliest marked stop.
+        rw->queue_count = 0;
+        for (int i = 0; i < rw->marked_count; i++) {
+            int v = rw->marked[i];
+            for (int k = tt->node_off[v]; k < tt->node_off[v+1]; k++) {
+                int s = tt->node_slot[k], ri = tt->slot_route[s];
+                const Mode *m = &modes[tt->routes[ri].mode];
+                if (!(q->mode_mask & (1u << tt->routes[ri].mode)) || m->interval == 0) continue;
+                if (rw->route_from[ri] < 0) { rw->route_from[ri] = s; rw->queue[rw->queue_count++] = ri; }
+                else if (s < rw->route_from[ri]) rw->route_from[ri] = s;
+            }
+        }
+        if (++rw->mark_gen == 0) { memset(rw->mark, 0, ws->n * sizeof(unsigned)); rw->mark_gen = 1; }
+        rw->marked_count = 0;
+        for (int i = 0; i < rw->queue_count; i++) {
+            int ri = rw->queue[i];
+            raptor_scan_route(&r, ri, rw->route_from[ri]);
+            rw->route_from[ri] = -1;
+        }
+        raptor_relax_edges(&r);
+    }
+    heap_clear(&ws->heap);
+    return ws->target >= 0 && raptor_fill_path(&r);
+}
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef UPDATE_H
+#define UPDATE_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "graph.h"
+#include "transit.h"
+
+// Live edits to a built graph, for closures, slowdowns and new segments during the day.
+// A closure or slowdown only sets the edge's speed factor: searches skip edges whose factor is 0
+// and ride the rest in dist / (speed * factor), so the CSR arrays are untouched and the edit is
+// O(1) per edge. Factors never exceed 1, which keeps every straight-line and landmark bound a
+// lower bound. A new segment does move edges: graph_insert_edges rebuilds the CSR with the new
+// edges after the existing ones of their tail nodes, in O(V + E) without reparsing anything,
+// and returns the old-to-new edge ids so the timetable and the reverse adjacency can follow.
+
+// Copies the arrays that still point into a mapped snapshot to the heap, so edits may replace
+// or change them.
+static inline void graph_own(Graph *g) {
+    if (!g->map) return;
+    int n = g->node_count, m = g->edge_count;
+    Coord *nodes = (Coord *)malloc((n ? n : 1) * sizeof(Coord));
+    int *off = (int *)malloc((n + 1) * sizeof(int)), *to = (int *)malloc((m ? m : 1) * sizeof(int));
+    double *dist = (double *)malloc((m ? m : 1) * sizeof(double));
+    unsigned char *mode = (unsigned char *)malloc(m ? m : 1);
+    memcpy(nodes, g->nodes, n * sizeof(Coord)); memcpy(off, g->off, (n + 1) * sizeof(int));
+    memcpy(to, g->to, m * sizeof(int)); memcpy(dist, g->dist, m * sizeof(double)); memcpy(mode, g->mode, m);
+    if (g->shape_off) {
+        int *shape_off = (int *)malloc((m + 1) * sizeof(int));
+        unsigned char *shape = (unsigned char *)malloc(g->shape_bytes ? g->shape_bytes : 1);
+        memcpy(shape_off, g->shape_off, (m + 1) * sizeof(int)); memcpy(shape, g->shape, g->shape_bytes);
+        g->shape_off = shape_off; g->shape = shape;
+    }
+    munmap(g->map, g->map_size);
+    g->map = NULL; g->map_size = 0;
+    g->nodes = nodes; g->off = off; g->to = to; g->dist = dist; g->mode = mode;
+    g->node_cap = n; g->edge_cap = m;
+}
+
+// Sets edge e's speed factor, 0 to close it; f is clamped to [0, 1].
+static inline void graph_set_factor(Graph *g, int e, double f) {
+    if (!g->factor) {
+        g->factor = (float *)malloc((g->edge_count ? g->edge_count : 1) * sizeof(float));
+        for (int i = 0; i < g->edge_count; i++) g->factor[i] = 1.0f;
+    }
+    g->factor[e] = (float)(f < 0 ? 0 : f > 1 ? 1 : f);
+}
+
+// Adds count edges from[i] -> to[i] to a built graph, each placed after the existing edges of
+// its tail, with no shape and factor 1. remap (edge_count entries, taken before the call)
+// receives every old edge's new id. A reverse adjacency is rebuilt if there was one.
+static inline void graph_insert_edges(Graph *g, int count, const int *from, const int *to, const double *dist,
+                                      const unsigned char *mode, int *remap) {
+    graph_own(g);
+    int n = g->node_count, m = g->edge_count, total = m + count;
+    int *off = (int *)calloc(n + 1, sizeof(int));
+    for (int u = 0; u < n; u++) off[u + 1] = g->off[u + 1] - g->off[u];
+    for (int i = 0; i < count; i++) off[from[i] + 1]++;
+    for (int u = 0; u < n; u++) off[u + 1] += off[u];
+    int *nto = (int *)malloc(total * sizeof(int));
+    double *ndist = (double *)malloc(total * sizeof(double));
+    unsigned char *nmode = (unsigned char *)malloc(total);
+    float *nfactor = g->factor ? (float *)malloc(total * sizeof(float)) : NULL;
+    int *shape_off = g->shape_off ? (int *)malloc((total + 1) * sizeof(int)) : NULL;
+    int *fill = (int *)malloc((n + 1) * sizeof(int));
+    memcpy(fill, off, (n + 1) * sizeof(int));
+    for (int u = 0; u < n; u++)
+        for (int e = g->off[u]; e < g->off[u+1]; e++) {
+            int slot = fill[u]++;
+            remap[e] = slot;
+            nto[slot] = g->to[e]; ndist[slot] = g->dist[e]; nmode[slot] = g->mode[e];
+            if (nfactor) nfactor[slot] = g->factor[e];
+        }
+    for (int i = 0; i < count; i++) {
+        int slot = fill[from[i]]++;
+        nto[slot] = to[i]; ndist[slot] = dist[i]; nmode[slot] = mode[i];
+        if (nfactor) nfactor[slot] = 1.0f;
+    }
+    if (shape_off) {
+        // Old edges keep their relative order, so the shape bytes stay put; new edges get empty runs.
+        int *len = (int *)calloc(total, sizeof(int));
+        for (int e = 0; e < m; e++) len[remap[e]] = g->shape_off[e + 1] - g->shape_off[e];
+        shape_off[0] = 0;
+        for (int e = 0; e < total; e++) shape_off[e + 1] = shape_off[e] + len[e];
+        free(g->shape_off); free(len);
+        g->shape_off = shape_off;
+    }
+    free(fill);
+    free(g->off); free(g->to); free(g->dist); free(g->mode); free(g->factor);
+    g->off = off; g->to = nto; g->dist = ndist; g->mode = nmode; g->factor = nfactor;
+    g->edge_count = g->edge_cap = total;
+    if (g->rev_off) {
+        free(g->rev_off); free(g->rev_edge); free(g->rev_from);
+        g->rev_off = NULL;
+        graph_build_reverse(g);
+    }
+}
+
+// Follows graph_insert_edges: points the stop slots at the edges' new ids.
+static inline void timetable_remap(Timetable *tt, const int *remap) {
+    for (int s = 0; s < tt->slot_count; s++) if (tt->slot_edge[s] >= 0) tt->slot_edge[s] = remap[tt->slot_edge[s]];
+}
+
+#endif